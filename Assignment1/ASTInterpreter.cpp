@@ -32,6 +32,7 @@ public:
 
         FunctionDecl *entry = mEnv.getEntry();
         mVisitor.VisitStmt(entry->getBody());
+        mEnv.finish();
     }
 
 private:
@@ -68,7 +69,9 @@ int main(int argc, char **argv) {
         fseek(fp, 0, SEEK_SET);
         fread(source, sizeof(char), fileSize, fp);
         fclose(fp);
-        clang::tooling::runToolOnCode(std::unique_ptr<clang::FrontendAction>(new InterpreterClassAction), source);
+        // Parsed as C++ like the code given on the command line, the real filename is only for diagnostics
+        clang::tooling::runToolOnCodeWithArgs(std::unique_ptr<clang::FrontendAction>(new InterpreterClassAction),
+                                              source, {"-x", "c++"}, argv[1]);
         free(source);
 #else
         clang::tooling::runToolOnCode(std::unique_ptr<clang::FrontendAction>(new InterpreterClassAction), argv[1]);
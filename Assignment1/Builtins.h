@@ -0,0 +1,15 @@
+#pragma once
+
+#include "clang/AST/Expr.h"
+
+using namespace clang;
+
+class Environment;
+
+// A function implemented by the interpreter itself, declared by the guest program as an `extern` prototype.
+// Pointer arguments are virtual heap addresses, counts are in `int` elements.
+struct Builtin {
+    const char *name;
+    void (Environment::*handler)(CallExpr *callExpr);  // Binds the return value to `callExpr` if any
+    bool writesMemory;                                  // Stores to or releases heap memory
+};
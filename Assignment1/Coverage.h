@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Stmt.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
+
+using namespace clang;
+
+// Execution counts of the guest statements, written as an lcov tracefile at exit.
+// Every statement numbered by the Environment owns the counter slot of its ID.
+class Coverage {
+private:
+    FILE *fp;
+    std::vector<uint64_t> stmtCounts;
+    std::vector<std::pair<FunctionDecl *, uint64_t>> funcCounts;
+    llvm::DenseMap<FunctionDecl *, uint32_t> funcSlots;
+
+public:
+    Coverage() : fp(nullptr) {}
+
+    ~Coverage() {
+        if (fp) fclose(fp);
+    }
+
+    Coverage(const Coverage &) = delete;
+
+    Coverage &operator=(const Coverage &) = delete;
+
+    bool open(const char *path) {
+        fp = fopen(path, "w");
+        return fp != nullptr;
+    }
+
+    bool isOpen() const {
+        return fp != nullptr;
+    }
+
+    void addStmts(uint32_t stmtCount) {
+        stmtCounts.resize(stmtCount);
+    }
+
+    void addFunction(FunctionDecl *fDecl) {
+        funcSlots.insert(std::make_pair(fDecl, funcCounts.size()));
+        funcCounts.emplace_back(fDecl, 0);
+    }
+
+    void hit(uint32_t stmtId, uint64_t times = 1) {
+        stmtCounts[stmtId] += times;
+    }
+
+    void call(FunctionDecl *fDecl) {
+        auto slotIter = funcSlots.find(fDecl);
+        if (slotIter != funcSlots.end()) funcCounts[slotIter->second].second++;
+    }
+
+    // One record per source file, a line counts as often as its most executed statement
+    void write(SourceManager &sourceManager, const llvm::DenseMap<Stmt *, uint32_t> &stmtIds) {
+        std::map<std::string, std::map<unsigned, uint64_t>> lineCounts;
+        for (auto &item: stmtIds) {
+            PresumedLoc loc = sourceManager.getPresumedLoc(item.first->getBeginLoc());
+            if (loc.isInvalid()) continue;
+            uint64_t &lineCount = lineCounts[loc.getFilename()][loc.getLine()];
+            lineCount = std::max(lineCount, stmtCounts[item.second]);
+        }
+        fprintf(fp, "TN:\n");
+        for (auto &file: lineCounts) {
+            fprintf(fp, "SF:%s\n", file.first.c_str());
+            uint32_t funcFound = 0, funcHit = 0;
+            for (auto &item: funcCounts) {
+                PresumedLoc loc = sourceManager.getPresumedLoc(item.first->getBeginLoc());
+                if (loc.isInvalid() || file.first != loc.getFilename()) continue;
+                std::string name = item.first->getNameAsString();
+                fprintf(fp, "FN:%u,%s\n", loc.getLine(), name.c_str());
+                fprintf(fp, "FNDA:%llu,%s\n", static_cast<unsigned long long>(item.second), name.c_str());
+                funcFound++;
+                if (item.second) funcHit++;
+            }
+            fprintf(fp, "FNF:%u\nFNH:%u\n", funcFound, funcHit);
+            uint32_t lineHit = 0;
+            for (auto &line: file.second) {
+                fprintf(fp, "DA:%u,%llu\n", line.first, static_cast<unsigned long long>(line.second));
+                if (line.second) lineHit++;
+            }
+            fprintf(fp, "LF:%zu\nLH:%u\nend_of_record\n", file.second.size(), lineHit);
+        }
+        fclose(fp);
+        fp = nullptr;
+    }
+};
@@ -4,6 +4,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
 #include <cctype>
 #include <vector>
 #include <algorithm>
@@ -12,15 +13,24 @@
 using namespace std;
 
 #include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/Tooling/Tooling.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseMap.h"
 
 using namespace clang;
 
 #include "InterpreterVisitor.h"
+#include "Builtins.h"
+#include "ExecutionLog.h"
+#include "Coverage.h"
+#include "Profiler.h"
+#include "VectorLoop.h"
+#include "LoopInvariants.h"
 
 typedef unsigned int uint_t;
 
@@ -54,8 +64,8 @@ private:
     public:
         chunkMeta(uint_t length, uint_t &addressAccumulator) {
             this->begin = addressAccumulator;;
+            this->capacity = static_cast<uint_t>(capacityOf(length)); // Checked to fit by Heap::allocate
             this->length = length = (length << 2); // patch here to prevent from char treated as int leading to OOB
-            this->capacity = (length + 7) & 0xfffffff8; // align chunk to 8 bytes
             addressAccumulator += capacity;
             this->pointer = static_cast<char *>(malloc(this->capacity));
         }
@@ -69,6 +79,19 @@ private:
 
         uint_t getLength() const { return length; }
 
+        uint_t getCapacity() const { return capacity; }
+
+        // Host bytes a chunk requested with `length` will occupy, in 64 bits so huge lengths don't wrap
+        static uint64_t capacityOf(uint_t length) {
+            return ((static_cast<uint64_t>(length) << 2) + 7) & ~static_cast<uint64_t>(7); // align chunk to 8 bytes
+        }
+
+        // Host memory backing [byteOffset, byteOffset + byteCount), nullptr if it leaves the chunk
+        int *range(uint_t byteOffset, uint_t byteCount) const {
+            if (byteOffset > length || byteCount > length - byteOffset) return nullptr;
+            return reinterpret_cast<int *>(pointer + byteOffset);
+        }
+
         int get(uint_t byteOffset) const {
             assert(byteOffset < length && byteOffset < capacity);
             int *intElemPtr = reinterpret_cast<int *>(pointer + byteOffset);
@@ -84,14 +107,15 @@ private:
 
     unsigned int addressAccumulator;
     vector<chunkMeta *> chunks;
+    uint_t quota; // in bytes, 0 means unlimited
+    uint_t usedBytes; // in bytes, capacity of all live chunks
 
-    chunkMeta *queryChunkMeta(int addr) const {
+    chunkMeta *findChunkMeta(int addr) const {
         auto findIter = find_if(chunks.begin(), chunks.end(), [&](chunkMeta *chunk) {
             uint_t begin = chunk->getBegin(), length = chunk->getLength();
             uint_t end = begin + length;
             return begin <= addr && addr < end;
         });
-        assert(findIter != chunks.end());
         if (findIter != chunks.end()) {
             return *findIter;
         } else {
@@ -99,10 +123,16 @@ private:
         }
     }
 
+    chunkMeta *queryChunkMeta(int addr) const {
+        chunkMeta *chunk = findChunkMeta(addr);
+        assert(chunk != nullptr);
+        return chunk;
+    }
+
 public:
     static Heap *allocator;
 
-    Heap() : addressAccumulator(0) {
+    Heap() : addressAccumulator(0), quota(0), usedBytes(0) {
         assert(allocator == nullptr);
         allocator = this;
     }
@@ -116,9 +146,25 @@ public:
         allocator = nullptr;
     }
 
+    void setQuota(uint_t bytes) {
+        quota = bytes;
+    }
+
+    uint_t getUsedBytes() const {
+        return usedBytes;
+    }
+
+    // Return -1 instead of allocating when the size is negative, the chunk overflows 32 bits or exceeds the quota
     int allocate(int size) {
+        if (size < 0) return -1;
+        uint64_t capacity = chunkMeta::capacityOf(size);
+        if (capacity > UINT32_MAX) return -1;
+        if (quota != 0 && (capacity > quota || usedBytes > quota - capacity)) {
+            return -1;
+        }
         chunkMeta *chunk = new chunkMeta(size, addressAccumulator);
         chunks.push_back(chunk);
+        usedBytes += chunk->getCapacity();
         return chunk->getBegin();
     }
 
@@ -126,6 +172,7 @@ public:
         // Remove only when `addr` is chunk's begin address
         chunks.erase(remove_if(chunks.begin(), chunks.end(), [&](chunkMeta *&chunk) {
             if (chunk->getBegin() == addr) {
+                usedBytes -= chunk->getCapacity();
                 delete chunk;
                 chunk = nullptr;
                 return true;
@@ -147,6 +194,13 @@ public:
         assert(byteOffset < chunk->getLength());
         return chunk->get(byteOffset);
     }
+
+    // Host memory backing `count` consecutive ints from `addr`, nullptr unless they all lie in one chunk
+    int *range(int addr, uint_t count) const {
+        chunkMeta *chunk = findChunkMeta(addr);
+        if (chunk == nullptr || count > UINT32_MAX / sizeof(int)) return nullptr;
+        return chunk->range(addr - chunk->getBegin(), count * sizeof(int));
+    }
 };
 
 
@@ -156,12 +210,17 @@ private:
     // Which are either integer or addresses (also represented using an Integer value)
     std::map<Decl *, int> mVars;
     std::map<Stmt *, int> mExprs;
-    // The current stmt
+    // The executing function and its current stmt
+    FunctionDecl *mFunction;
     Stmt *mPC;
     int mRetVal;
     bool mHasRetVal;
+    // Loops being executed, innermost last
+    vector<LoopInvariants *> mLoops;
+    // Invariants whose value in `mExprs` is reusable, with the loop they are invariant to
+    llvm::DenseMap<Stmt *, LoopInvariants *> mCachedInvariants;
 public:
-    StackFrame() : mVars(), mExprs(), mPC(), mRetVal(0), mHasRetVal(false) {}
+    StackFrame() : mVars(), mExprs(), mFunction(), mPC(), mRetVal(0), mHasRetVal(false), mLoops(), mCachedInvariants() {}
 
     ~StackFrame() {
         for_each(mVars.begin(), mVars.end(), [&](pair<Decl *const, int> item) {
@@ -201,10 +260,18 @@ public:
         mPC = stmt;
     }
 
-    Stmt *getPC() {
+    Stmt *getPC() const {
         return mPC;
     }
 
+    void setFunction(FunctionDecl *function) {
+        mFunction = function;
+    }
+
+    FunctionDecl *getFunction() const {
+        return mFunction;
+    }
+
     void setRetVal(int retVal) {
         mRetVal = retVal;
         mHasRetVal = true;
@@ -217,44 +284,154 @@ public:
     bool hasRetVal() const {
         return mHasRetVal;
     }
+
+    void enterLoop(LoopInvariants *loop) {
+        mLoops.push_back(loop);
+    }
+
+    void exitLoop() {
+        LoopInvariants *loop = mLoops.back();
+        mLoops.pop_back();
+        for (Stmt *stmt: loop->exprs) {
+            auto cacheIter = mCachedInvariants.find(stmt);
+            if (cacheIter != mCachedInvariants.end() && cacheIter->second == loop) mCachedInvariants.erase(cacheIter);
+        }
+    }
+
+    bool isInLoop() const {
+        return !mLoops.empty();
+    }
+
+    // Whether the value of `stmt` bound in this frame can be reused instead of evaluating it again
+    bool reuseInvariant(Stmt *stmt) {
+        auto cacheIter = mCachedInvariants.find(stmt);
+        if (cacheIter == mCachedInvariants.end()) return false;
+        cacheIter->second->savedEvals++;
+        return true;
+    }
+
+    // Keep the value of `stmt` just evaluated for the outermost executing loop it's invariant to
+    void cacheInvariant(Stmt *stmt) {
+        for (LoopInvariants *loop: mLoops) {
+            if (loop->exprs.count(stmt)) {
+                mCachedInvariants[stmt] = loop;
+                return;
+            }
+        }
+    }
 };
 
+// Read an unsigned integer setting from the process environment
+static inline uint64_t getEnvUInt(const char *name, uint64_t defaultVal) {
+    const char *str = getenv(name);
+    if (str == nullptr || *str == '\0') return defaultVal;
+    return strtoull(str, nullptr, 0);
+}
+
 class Environment {
 private:
     InterpreterVisitor *iVisitor;
+    ASTContext *iContext;
+
+    uint64_t dFuel;             // Statements and loop back-edges left to execute
+    llvm::DenseMap<Stmt *, uint_t> dStmtIds; // Dense IDs of statements accounted by `enterStmt`
+    ExecutionLog dLog;          // Record or replay of GET() inputs and MALLOC() addresses
+    ExecutionTrace dTrace;      // Executed statement IDs
+    Coverage dCoverage;         // Execution counts of statements and functions
+    SamplingProfiler<StackFrame> dProfiler; // Guest call stacks sampled on SIGPROF
+    llvm::DenseMap<ForStmt *, CountedLoop> dCountedLoops; // Recognized shapes of executed `for` loops
+    std::map<Stmt *, LoopInvariants> dLoopInvariants;      // Invariants of executed loops, referenced by frames
+    bool dPrintStats;           // Report execution statistics at exit
 
     Heap dHeap;
     vector<StackFrame> dStack;
     StaticStorage dStaticData;
 
-    FunctionDecl *fFree;        // Declarations to the built-in functions
-    FunctionDecl *fMalloc;
-    FunctionDecl *fInput;
-    FunctionDecl *fOutput;
+    llvm::DenseMap<FunctionDecl *, const Builtin *> fBuiltins; // Canonical declarations to the built-in functions
     FunctionDecl *fEntry;       // Program entrypoint
 
 public:
-    Environment() : fFree(nullptr), fMalloc(nullptr),
-                    fInput(nullptr), fOutput(nullptr), fEntry(nullptr) {}
+    Environment() : iVisitor(nullptr), iContext(nullptr), dFuel(UINT64_MAX), dPrintStats(false),
+                    fBuiltins(), fEntry(nullptr) {}
+
+    // Functions the guest program may declare and call without defining them
+    static const vector<Builtin> &getBuiltins() {
+        static const vector<Builtin> builtins = {
+                {"GET",     &Environment::builtinGet,     false},
+                {"PRINT",   &Environment::builtinPrint,   false},
+                {"MALLOC",  &Environment::builtinMalloc,  false},
+                {"FREE",    &Environment::builtinFree,    true},
+                {"FILL",    &Environment::builtinFill,    true},
+                {"COPY",    &Environment::builtinCopy,    true},
+                {"COMPARE", &Environment::builtinCompare, false},
+                {"ABS",     &Environment::builtinAbs,     false},
+                {"MIN",     &Environment::builtinMin,     false},
+                {"MAX",     &Environment::builtinMax,     false},
+        };
+        return builtins;
+    }
 
 
     // Initialize the Environment
     void init(TranslationUnitDecl *unit, InterpreterVisitor *visitor) {
         iVisitor = visitor;
+        iContext = &unit->getASTContext();
+        // Execution limits, both unlimited when unset or 0
+        dFuel = getEnvUInt("ASSIGNMENT_FUEL", 0);
+        if (dFuel == 0) dFuel = UINT64_MAX;
+        dHeap.setQuota(getEnvUInt("ASSIGNMENT_HEAP_QUOTA", 0));
+        dPrintStats = getEnvUInt("ASSIGNMENT_STATS", 0) != 0;
+        // Execution logs
+        if (const char *path = getenv("ASSIGNMENT_REPLAY")) {
+            if (!dLog.openReplay(path)) {
+                perror("Unable to open replay log");
+                exit(EXIT_FAILURE);
+            }
+        } else if (const char *path = getenv("ASSIGNMENT_RECORD")) {
+            if (!dLog.openRecord(path)) {
+                perror("Unable to open record log");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (const char *path = getenv("ASSIGNMENT_TRACE")) {
+            if (!dTrace.open(path)) {
+                perror("Unable to open trace");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (const char *path = getenv("ASSIGNMENT_COVERAGE")) {
+            if (!dCoverage.open(path)) {
+                perror("Unable to open coverage file");
+                exit(EXIT_FAILURE);
+            }
+        }
         // Prevent `dStack` vector from reallocating thus automatically freeing auto array on heap won't happen,
         // meanwhile the stack depth is limited to 1024.
         dStack.reserve(1024);
         // Create initialization stack frame
         dStack.emplace_back();
+        // The profiler samples `dStack` from a signal handler, arm it only once the vector stops moving
+        if (const char *path = getenv("ASSIGNMENT_PROFILE")) {
+            if (!dProfiler.open(path, &dStack, getEnvUInt("ASSIGNMENT_PROFILE_HZ", 1000))) {
+                perror("Unable to open profile");
+                exit(EXIT_FAILURE);
+            }
+        }
         // Do initialization
         for (TranslationUnitDecl::decl_iterator i = unit->decls_begin(), e = unit->decls_end(); i != e; ++i) {
             if (FunctionDecl *fDecl = dyn_cast<FunctionDecl>(*i)) {
-                // Collect the Declarations to the built-in function pointers
-                if (fDecl->getName().equals("FREE")) fFree = fDecl;
-                else if (fDecl->getName().equals("MALLOC")) fMalloc = fDecl;
-                else if (fDecl->getName().equals("GET")) fInput = fDecl;
-                else if (fDecl->getName().equals("PRINT")) fOutput = fDecl;
-                else if (fDecl->getName().equals("main")) fEntry = fDecl;
+                // Collect the Declarations to the built-in function pointers, unless the program defines its own
+                for (const Builtin &builtin: getBuiltins()) {
+                    if (fDecl->getName().equals(builtin.name) && fDecl->getDefinition() == nullptr) {
+                        fBuiltins[fDecl->getCanonicalDecl()] = &builtin;
+                    }
+                }
+                if (fDecl->getName().equals("main")) fEntry = fDecl;
+                // Number the statements in declaration order so that IDs are stable between runs
+                if (fDecl->doesThisDeclarationHaveABody()) {
+                    numberStmts(fDecl->getBody());
+                    if (dCoverage.isOpen()) dCoverage.addFunction(fDecl);
+                }
 #ifdef ASSIGNMENT_DEBUG_DUMP
                 if (fDecl->getDefinition() == nullptr) {
                     fprintf(stderr, "[+] Function prototype %s on %p.\n",
@@ -279,10 +456,14 @@ public:
 #endif
             }
         }
+        // One counter slot per statement ID
+        if (dCoverage.isOpen()) dCoverage.addStmts(dStmtIds.size());
         // Pop the initialization stack frame
         dStack.pop_back();
         // Create stack frame for main
         dStack.emplace_back();
+        dStack.back().setFunction(fEntry);
+        if (dCoverage.isOpen()) dCoverage.call(fEntry);
 #ifdef ASSIGNMENT_DEBUG_DUMP
         fprintf(stderr, "[*] Entering entrypoint main on %p.\n", fEntry);
 #endif
@@ -313,6 +494,114 @@ public:
         return fEntry;
     }
 
+    // Report where the guest program stopped, flush its partial output and terminate
+    void abortExecution(const char *reason) {
+        fflush(stdout);
+        llvm::errs() << "[!] Execution stopped: " << reason << ".\n";
+        for (auto frame = dStack.rbegin(); frame != dStack.rend(); ++frame) {
+            Stmt *pc = frame->getPC();
+            if (pc == nullptr) continue;
+            llvm::errs() << "\tat ";
+            printLocation(pc);
+            llvm::errs() << "\n";
+        }
+        llvm::errs() << "\theap in use: " << dHeap.getUsedBytes() << " bytes\n";
+        writeReports();
+        exit(EXIT_FAILURE);
+    }
+
+    // Print `file:line:col` of `stmt` to STDERR
+    void printLocation(Stmt *stmt) {
+        PresumedLoc loc = iContext->getSourceManager().getPresumedLoc(stmt->getBeginLoc());
+        if (loc.isInvalid()) {
+            llvm::errs() << "<unknown>";
+        } else {
+            llvm::errs() << loc.getFilename() << ":" << loc.getLine() << ":" << loc.getColumn();
+        }
+    }
+
+    // Write the coverage and profile files requested
+    void writeReports() {
+        if (dCoverage.isOpen()) dCoverage.write(iContext->getSourceManager(), dStmtIds);
+        if (dProfiler.isOpen()) dProfiler.write(iContext->getSourceManager());
+    }
+
+    // Called after the entrypoint returns
+    void finish() {
+        writeReports();
+        if (!dPrintStats) return;
+        uint64_t savedEvals = 0, invariantCount = 0;
+        for (auto &item: dLoopInvariants) {
+            savedEvals += item.second.savedEvals;
+            invariantCount += item.second.exprs.size();
+        }
+        llvm::errs() << "[*] Loop invariants: " << savedEvals << " evaluations saved by " << invariantCount
+                     << " expressions in " << dLoopInvariants.size() << " executed loops.\n";
+        for (auto &item: dLoopInvariants) {
+            if (item.second.exprs.empty()) continue;
+            llvm::errs() << "\tloop at ";
+            printLocation(item.first);
+            llvm::errs() << ": " << item.second.exprs.size() << " invariants, "
+                         << item.second.savedEvals << " evaluations saved\n";
+        }
+    }
+
+    // Whether `child` is executed as a statement of its own, i.e. accounted by `enterStmt`
+    static bool isEnteredStmt(Stmt *parent, Stmt *child) {
+        if (isa<CompoundStmt>(parent)) return true;
+        if (IfStmt *ifStmt = dyn_cast<IfStmt>(parent)) return child == ifStmt->getThen() || child == ifStmt->getElse();
+        if (WhileStmt *whileStmt = dyn_cast<WhileStmt>(parent)) return child == whileStmt->getBody();
+        if (ForStmt *forStmt = dyn_cast<ForStmt>(parent)) return child == forStmt->getBody();
+        return false;
+    }
+
+    void numberStmts(Stmt *stmt) {
+        for (auto *subStmt: stmt->children()) {
+            if (subStmt == nullptr) continue;
+            if (isEnteredStmt(stmt, subStmt)) {
+                uint_t stmtId = dStmtIds.size();
+                dStmtIds.insert(std::make_pair(subStmt, stmtId));
+            }
+            numberStmts(subStmt);
+        }
+    }
+
+    // Account one executed statement or loop back-edge against the fuel
+    void enterStmt(Stmt *stmt) {
+        dStack.back().setPC(stmt);
+        if (dFuel == 0) abortExecution("instruction budget exhausted");
+        --dFuel;
+        if (dProfiler.hasBacklog()) dProfiler.drain();
+        if (dTrace.isOpen() || dCoverage.isOpen()) {
+            uint_t stmtId = dStmtIds.lookup(stmt);
+            if (dTrace.isOpen()) dTrace.write(stmtId);
+            if (dCoverage.isOpen()) dCoverage.hit(stmtId);
+        }
+    }
+
+    // Visit `stmt` unless it's a loop invariant already evaluated in this execution of the loop
+    void evaluate(Stmt *stmt) {
+        if (!dStack.back().isInLoop()) {
+            iVisitor->Visit(stmt);
+            return;
+        }
+        if (dStack.back().reuseInvariant(stmt)) return;
+        iVisitor->Visit(stmt);
+        dStack.back().cacheInvariant(stmt);
+    }
+
+    void enterLoop(Stmt *loop) {
+        auto invariantsIter = dLoopInvariants.find(loop);
+        if (invariantsIter == dLoopInvariants.end()) {
+            invariantsIter = dLoopInvariants.insert(std::make_pair(loop, LoopInvariants::analyze(loop, fBuiltins))).first;
+        }
+        dStack.back().enterLoop(&invariantsIter->second);
+    }
+
+    void exitLoop() {
+        dStack.back().exitLoop();
+    }
+
     void integerLiteral(IntegerLiteral *intLiteral) {
         int literalVal = intLiteral->getValue().getSExtValue();
         dStack.back().bindStmt(intLiteral, literalVal);
@@ -436,7 +725,7 @@ public:
                 if (vardecl->getType()->isIntegerType()) {
                     if (vardecl->hasInit()) {
                         Expr *initExpr = vardecl->getInit();
-                        iVisitor->Visit(initExpr);
+                        evaluate(initExpr);
                         initVal = dStack.back().getStmtVal(initExpr);
                     }
 #ifdef ASSIGNMENT_DEBUG_DUMP
@@ -447,6 +736,7 @@ public:
                     const ConstantArrayType *constArrType = dyn_cast<ConstantArrayType>(vardecl->getType());
                     unsigned int arrLength = constArrType->getSize().getZExtValue();
                     int heapAddr = Heap::allocator->allocate(arrLength * sizeof(int));
+                    if (heapAddr == -1) abortExecution("heap quota exceeded");
                     initVal = heapAddr;
 #ifdef ASSIGNMENT_DEBUG_DUMP
                     fprintf(stderr, "[+] Local array %s[%u] at VMHeapAddr 0x%x, size %lu, on %p.\n",
@@ -506,35 +796,18 @@ public:
         fprintf(stderr, "[*] Calling function: %s on %p, definition on %p.\n", callee->getName().bytes_begin(), callee,
                 callee->getDefinition());
 #endif
-        if (callee == fInput) {
-            int val;
-#ifndef ASSIGNMENT_DEBUG
-            llvm::errs() << "Please Input an Integer Value : ";
-#endif
-            scanf("%d", &val);
-            dStack.back().bindStmt(callexpr, val);
-        } else if (callee == fOutput) {
-            Expr *outputExp = callexpr->getArg(0);
-            int val = dStack.back().getStmtVal(outputExp);
-#ifndef ASSIGNMENT_DEBUG
-            llvm::errs() << val;
-#else
-            printf("%d\n", val);
-#endif
-        } else if (callee == fMalloc) {
-            Expr *chunkSizeExpr = callexpr->getArg(0);
-            int chunkSize = dStack.back().getStmtVal(chunkSizeExpr);
-            int chunkVMAddr = dHeap.allocate(chunkSize);
-            dStack.back().bindStmt(callexpr, chunkVMAddr);
-        } else if (callee == fFree) {
-            Expr *chunkVMAddrExpr = callexpr->getArg(0);
-            int chunkVMAddr = dStack.back().getStmtVal(chunkVMAddrExpr);
-            dHeap.release(chunkVMAddr);
+        auto builtinIter = fBuiltins.find(callee->getCanonicalDecl());
+        if (builtinIter != fBuiltins.end()) {
+            (this->*builtinIter->second->handler)(callexpr);
         } else { // For customized functions, handle call & return here
             // Get real definition instead of prototype or unable to visit its statement & its variables
             callee = callee->getDefinition();
+            // Growing `dStack` beyond its reserved capacity would move frames and release their auto arrays
+            if (dStack.size() == dStack.capacity()) abortExecution("stack depth limit exceeded");
+            if (dCoverage.isOpen()) dCoverage.call(callee);
             // Create new call stack
             dStack.emplace_back();
+            dStack.back().setFunction(callee);
 #define oldFrame (dStack.end() - 2)
 #define newFrame (dStack.end() - 1)
             // Copy argument values to corresponding parameter bindings
@@ -561,6 +834,104 @@ public:
         }
     }
 
+    int getArgVal(CallExpr *callexpr, uint_t argIndex) {
+        return dStack.back().getStmtVal(callexpr->getArg(argIndex));
+    }
+
+    // Backing memory of `count` ints from `addr` for a bulk built-in, stopping execution on a bad range
+    int *getBuiltinRange(const char *reason, int addr, int count) {
+        int *range = count >= 0 ? dHeap.range(addr, count) : nullptr;
+        if (range == nullptr) abortExecution(reason);
+        return range;
+    }
+
+    // int GET()
+    void builtinGet(CallExpr *callexpr) {
+        int val;
+        if (dLog.isReplaying()) {
+            if (!dLog.replay(ExecutionLog::EVENT_INPUT, &val)) abortExecution("replay log diverged at GET()");
+        } else {
+#ifndef ASSIGNMENT_DEBUG
+            llvm::errs() << "Please Input an Integer Value : ";
+#endif
+            scanf("%d", &val);
+            if (dLog.isRecording()) dLog.record(ExecutionLog::EVENT_INPUT, val);
+        }
+        dStack.back().bindStmt(callexpr, val);
+    }
+
+    // void PRINT(int val)
+    void builtinPrint(CallExpr *callexpr) {
+        int val = getArgVal(callexpr, 0);
+#ifndef ASSIGNMENT_DEBUG
+        llvm::errs() << val;
+#else
+        printf("%d\n", val);
+#endif
+    }
+
+    // void *MALLOC(int size)
+    void builtinMalloc(CallExpr *callexpr) {
+        int chunkSize = getArgVal(callexpr, 0);
+        int chunkVMAddr = dHeap.allocate(chunkSize);
+        if (chunkVMAddr == -1) abortExecution("heap quota exceeded");
+        if (dLog.isRecording()) {
+            dLog.record(ExecutionLog::EVENT_MALLOC, chunkVMAddr);
+        } else if (dLog.isReplaying()) {
+            int loggedVMAddr;
+            if (!dLog.replay(ExecutionLog::EVENT_MALLOC, &loggedVMAddr) || loggedVMAddr != chunkVMAddr)
+                abortExecution("replay log diverged at MALLOC()");
+        }
+        dStack.back().bindStmt(callexpr, chunkVMAddr);
+    }
+
+    // void FREE(void *addr)
+    void builtinFree(CallExpr *callexpr) {
+        int chunkVMAddr = getArgVal(callexpr, 0);
+        dHeap.release(chunkVMAddr);
+    }
+
+    // void FILL(int *dst, int val, int count)
+    void builtinFill(CallExpr *callexpr) {
+        int val = getArgVal(callexpr, 1), count = getArgVal(callexpr, 2);
+        int *dst = getBuiltinRange("FILL() out of heap chunk", getArgVal(callexpr, 0), count);
+        std::fill(dst, dst + count, val);
+    }
+
+    // void COPY(int *dst, int *src, int count), the ranges may overlap
+    void builtinCopy(CallExpr *callexpr) {
+        int count = getArgVal(callexpr, 2);
+        int *dst = getBuiltinRange("COPY() out of heap chunk", getArgVal(callexpr, 0), count);
+        int *src = getBuiltinRange("COPY() out of heap chunk", getArgVal(callexpr, 1), count);
+        memmove(dst, src, count * sizeof(int));
+    }
+
+    // int COMPARE(int *lhs, int *rhs, int count), -1, 0 or 1 comparing the ranges lexicographically
+    void builtinCompare(CallExpr *callexpr) {
+        int count = getArgVal(callexpr, 2);
+        int *lhs = getBuiltinRange("COMPARE() out of heap chunk", getArgVal(callexpr, 0), count);
+        int *rhs = getBuiltinRange("COMPARE() out of heap chunk", getArgVal(callexpr, 1), count);
+        auto mismatch = std::mismatch(lhs, lhs + count, rhs);
+        int result = mismatch.first == lhs + count ? 0 : *mismatch.first < *mismatch.second ? -1 : 1;
+        dStack.back().bindStmt(callexpr, result);
+    }
+
+    // int ABS(int val)
+    void builtinAbs(CallExpr *callexpr) {
+        int val = getArgVal(callexpr, 0);
+        dStack.back().bindStmt(callexpr, val < 0 ? -val : val);
+    }
+
+    // int MIN(int lhs, int rhs)
+    void builtinMin(CallExpr *callexpr) {
+        dStack.back().bindStmt(callexpr, std::min(getArgVal(callexpr, 0), getArgVal(callexpr, 1)));
+    }
+
+    // int MAX(int lhs, int rhs)
+    void builtinMax(CallExpr *callexpr) {
+        dStack.back().bindStmt(callexpr, std::max(getArgVal(callexpr, 0), getArgVal(callexpr, 1)));
+    }
+
     void parenExpr(ParenExpr *parenExpr) {
         Expr *subExpr = parenExpr->getSubExpr();
         int val = dStack.back().getStmtVal(subExpr);
@@ -579,12 +950,14 @@ public:
 
     void ifStmt(IfStmt *ifStmt) {
         Expr *condExpr = ifStmt->getCond();
-        iVisitor->Visit(condExpr);
+        evaluate(condExpr);
         int condVal = dStack.back().getStmtVal(condExpr);
         if (condVal != 0) {
+            enterStmt(ifStmt->getThen());
             iVisitor->Visit(ifStmt->getThen());
         } else {
             if (ifStmt->hasElseStorage()) {
+                enterStmt(ifStmt->getElse());
                 iVisitor->Visit(ifStmt->getElse());
             }
         }
@@ -592,12 +965,80 @@ public:
 
     void whileStmt(WhileStmt *whileStmt) {
         Expr *condExpr = whileStmt->getCond();
+        enterLoop(whileStmt);
         while (true) {
-            iVisitor->Visit(condExpr);
+            evaluate(condExpr);
             int condVal = dStack.back().getStmtVal(condExpr);
             if (condVal == 0) break;
+            enterStmt(whileStmt->getBody()); // Loop back-edge
             iVisitor->Visit(whileStmt->getBody());
         }
+        exitLoop();
+    }
+
+    // Run a recognized counted loop with SIMD host kernels, false to fall back to interpreting it
+    bool runCountedLoop(ForStmt *forStmt) {
+        if (dTrace.isOpen()) return false; // Every iteration has to be traced
+        auto cacheIter = dCountedLoops.find(forStmt);
+        if (cacheIter == dCountedLoops.end()) {
+            cacheIter = dCountedLoops.insert(std::make_pair(forStmt, CountedLoop::match(forStmt))).first;
+        }
+        const CountedLoop &loop = cacheIter->second;
+        if (loop.kind == CountedLoop::NONE) return false;
+
+        int begin = getDeclVal(loop.indexVar);
+        int end = getScalarVal(loop.bound);
+        if (begin >= end) return false;
+        uint_t count = static_cast<uint_t>(static_cast<int64_t>(end) - begin);
+        // Same fuel as interpreting: the back-edge, plus the statement when the body is a block
+        uint64_t fuelCost = static_cast<uint64_t>(count) * (isa<CompoundStmt>(forStmt->getBody()) ? 2 : 1);
+        if (fuelCost > dFuel) return false;
+
+        if (loop.kind == CountedLoop::MAP) {
+            int *dst = getElementRange(loop.dst, begin, count);
+            int *lhs = getElementRange(loop.lhs, begin, count);
+            int *rhs = getElementRange(loop.rhs, begin, count);
+            if (!dst || loop.lhs.isArray() && !lhs || loop.rhs.isArray() && !rhs) return false;
+            // Element-wise is fine when sources are the destination itself, not when they overlap it shifted
+            auto overlaps = [&](int *src) {
+                return src && src != dst && src < dst + count && dst < src + count;
+            };
+            if (overlaps(lhs) || overlaps(rhs)) return false;
+            int lhsScalar = lhs ? 0 : getScalarVal(loop.lhs.scalar);
+            int rhsScalar = rhs ? 0 : getScalarVal(loop.rhs.scalar);
+            VectorKernel::elementwise(loop.op, dst, lhs, lhsScalar, rhs, rhsScalar, count);
+        } else { // CountedLoop::REDUCE
+            int *src = getElementRange(loop.lhs, begin, count);
+            if (!src) return false;
+            bindDecl(loop.accumulator, VectorKernel::sum(getDeclVal(loop.accumulator), src, count));
+        }
+#ifdef ASSIGNMENT_DEBUG_DUMP
+        fprintf(stderr, "[*] Vectorized loop %p over %u iterations.\n", forStmt, count);
+#endif
+        bindDecl(loop.indexVar, end);
+        dFuel -= fuelCost;
+        if (dCoverage.isOpen()) {
+            Stmt *body = forStmt->getBody();
+            dCoverage.hit(dStmtIds.lookup(body), count);
+            if (CompoundStmt *block = dyn_cast<CompoundStmt>(body)) {
+                dCoverage.hit(dStmtIds.lookup(block->body_front()), count);
+            }
+        }
+        return true;
+    }
+
+    int getScalarVal(Expr *scalar) {
+        if (IntegerLiteral *intLiteral = dyn_cast<IntegerLiteral>(scalar)) {
+            return intLiteral->getValue().getSExtValue();
+        }
+        return getDeclVal(cast<DeclRefExpr>(scalar)->getFoundDecl());
+    }
+
+    // Backing memory of `base[begin]` ... `base[begin + count - 1]`, nullptr for scalars or when out of a chunk
+    int *getElementRange(const CountedLoop::Operand &operand, int begin, uint_t count) {
+        if (!operand.isArray()) return nullptr;
+        int baseHeapAddr = getDeclVal(operand.arrayBase);
+        return dHeap.range(baseHeapAddr + begin * static_cast<int>(sizeof(int)), count);
     }
 
     void forStmt(ForStmt *forStmt) {
@@ -606,21 +1047,27 @@ public:
         if (initExpr) {
             iVisitor->Visit(forStmt->getInit());
         }
+        if (runCountedLoop(forStmt)) return;
 
+        enterLoop(forStmt);
         while (true) {
-            iVisitor->Visit(condExpr);
+            evaluate(condExpr);
             int condVal = dStack.back().getStmtVal(condExpr);
             if (condVal == 0) break;
+            enterStmt(forStmt->getBody()); // Loop back-edge
             iVisitor->Visit(forStmt->getBody());
             iVisitor->Visit(forStmt->getInc());
         }
+        exitLoop();
     }
 
     void stmt(Stmt *stmt) {
+        bool isBlock = isa<CompoundStmt>(stmt);
         for (auto *SubStmt: stmt->children()) {
             if (dStack.back().hasRetVal()) break; // Stop from executing current function after return statement
             if (SubStmt) {
-                iVisitor->Visit(SubStmt);
+                if (isBlock) enterStmt(SubStmt);
+                evaluate(SubStmt);
             }
         }
     }
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+// Binary log of the nondeterministic events of a guest execution, i.e. `GET()` inputs and `MALLOC()` addresses.
+// Layout: 8 bytes magic, then one record per event: 1 byte event kind + 4 bytes little-endian value.
+class ExecutionLog {
+public:
+    enum EventKind : unsigned char {
+        EVENT_INPUT = 'I',
+        EVENT_MALLOC = 'M'
+    };
+
+private:
+    static constexpr const char *MAGIC = "ASTLOG1\n";
+
+    FILE *fp;
+    bool replaying;
+
+public:
+    ExecutionLog() : fp(nullptr), replaying(false) {}
+
+    ~ExecutionLog() {
+        if (fp) fclose(fp);
+    }
+
+    ExecutionLog(const ExecutionLog &) = delete;
+
+    ExecutionLog &operator=(const ExecutionLog &) = delete;
+
+    bool openRecord(const char *path) {
+        fp = fopen(path, "wb");
+        if (fp == nullptr) return false;
+        fwrite(MAGIC, 1, strlen(MAGIC), fp);
+        return true;
+    }
+
+    bool openReplay(const char *path) {
+        char magic[8];
+        fp = fopen(path, "rb");
+        if (fp == nullptr) return false;
+        if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, MAGIC, sizeof(magic)) != 0) {
+            fclose(fp);
+            fp = nullptr;
+            return false;
+        }
+        replaying = true;
+        return true;
+    }
+
+    bool isRecording() const {
+        return fp != nullptr && !replaying;
+    }
+
+    bool isReplaying() const {
+        return fp != nullptr && replaying;
+    }
+
+    void record(EventKind kind, int value) {
+        uint32_t bits = static_cast<uint32_t>(value);
+        unsigned char buf[5] = {kind,
+                                static_cast<unsigned char>(bits), static_cast<unsigned char>(bits >> 8),
+                                static_cast<unsigned char>(bits >> 16), static_cast<unsigned char>(bits >> 24)};
+        fwrite(buf, 1, sizeof(buf), fp);
+    }
+
+    // Fetch the next event, false when the log is exhausted or holds another kind of event here
+    bool replay(EventKind kind, int *value) {
+        unsigned char buf[5];
+        if (fread(buf, 1, sizeof(buf), fp) != sizeof(buf) || buf[0] != kind) return false;
+        *value = static_cast<int>(buf[1] | buf[2] << 8 | buf[3] << 16 | static_cast<uint32_t>(buf[4]) << 24);
+        return true;
+    }
+};
+
+// Binary trace of executed statement IDs for offline diffing, see `testcase/trace_dump.py`.
+// Layout: 8 bytes magic, then every ID as the zigzag LEB128 varint of its delta to the previous ID.
+class ExecutionTrace {
+private:
+    static constexpr const char *MAGIC = "ASTTRC1\n";
+
+    FILE *fp;
+    int64_t lastId;
+
+public:
+    ExecutionTrace() : fp(nullptr), lastId(0) {}
+
+    ~ExecutionTrace() {
+        if (fp) fclose(fp);
+    }
+
+    ExecutionTrace(const ExecutionTrace &) = delete;
+
+    ExecutionTrace &operator=(const ExecutionTrace &) = delete;
+
+    bool open(const char *path) {
+        fp = fopen(path, "wb");
+        if (fp == nullptr) return false;
+        fwrite(MAGIC, 1, strlen(MAGIC), fp);
+        return true;
+    }
+
+    bool isOpen() const {
+        return fp != nullptr;
+    }
+
+    void write(uint32_t stmtId) {
+        int64_t delta = static_cast<int64_t>(stmtId) - lastId;
+        uint64_t zigzag = (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+        lastId = stmtId;
+        do {
+            unsigned char byte = zigzag & 0x7f;
+            zigzag >>= 7;
+            putc(zigzag ? (byte | 0x80) : byte, fp);
+        } while (zigzag);
+    }
+};
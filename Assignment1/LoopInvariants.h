@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+
+using namespace clang;
+
+#include "Builtins.h"
+
+// Side-effect free subexpressions of a `while` or `for` loop whose operands are not written by any iteration.
+// Within one execution of the loop such an expression is evaluated the first time it's reached,
+// following iterations reuse the value still bound in the stack frame.
+struct LoopInvariants {
+    llvm::DenseSet<Stmt *> exprs;   // Maximal invariant subexpressions of the condition, body and increment
+    uint64_t savedEvals;            // Evaluations skipped over all executions of the loop
+
+    LoopInvariants() : exprs(), savedEvals(0) {}
+
+    static LoopInvariants analyze(Stmt *loop, const llvm::DenseMap<FunctionDecl *, const Builtin *> &builtins) {
+        LoopInvariants invariants;
+        Effects effects(builtins);
+        // Only the parts executed in every iteration, `for` initialization runs once
+        Stmt *parts[3] = {};
+        if (WhileStmt *whileStmt = dyn_cast<WhileStmt>(loop)) {
+            parts[0] = whileStmt->getCond();
+            parts[1] = whileStmt->getBody();
+        } else if (ForStmt *forStmt = dyn_cast<ForStmt>(loop)) {
+            parts[0] = forStmt->getCond();
+            parts[1] = forStmt->getBody();
+            parts[2] = forStmt->getInc();
+        }
+        for (Stmt *part: parts) {
+            if (part) effects.collect(part);
+        }
+        for (Stmt *part: parts) {
+            if (part && invariants.collect(part, effects)) invariants.add(part);
+        }
+        return invariants;
+    }
+
+private:
+    // What an iteration may write
+    struct Effects {
+        const llvm::DenseMap<FunctionDecl *, const Builtin *> &builtins;
+        llvm::DenseSet<Decl *> writtenDecls;
+        bool writesGlobals;     // By a called function
+        bool writesMemory;      // Heap stores, calls to functions or to memory writing built-ins
+
+        explicit Effects(const llvm::DenseMap<FunctionDecl *, const Builtin *> &builtins)
+                : builtins(builtins), writtenDecls(), writesGlobals(false), writesMemory(false) {}
+
+        void collect(Stmt *stmt) {
+            if (BinaryOperator *bop = dyn_cast<BinaryOperator>(stmt)) {
+                if (bop->isAssignmentOp()) write(bop->getLHS());
+            } else if (UnaryOperator *uop = dyn_cast<UnaryOperator>(stmt)) {
+                if (uop->isIncrementDecrementOp()) write(uop->getSubExpr());
+            } else if (DeclStmt *declStmt = dyn_cast<DeclStmt>(stmt)) {
+                // Re-initialized by every iteration
+                for (Decl *decl: declStmt->decls()) writtenDecls.insert(decl);
+            } else if (CallExpr *callExpr = dyn_cast<CallExpr>(stmt)) {
+                FunctionDecl *callee = callExpr->getDirectCallee();
+                auto builtinIter = callee ? builtins.find(callee->getCanonicalDecl()) : builtins.end();
+                if (builtinIter == builtins.end()) {
+                    writesGlobals = writesMemory = true;
+                } else if (builtinIter->second->writesMemory) {
+                    writesMemory = true;
+                }
+            }
+            for (Stmt *subStmt: stmt->children()) {
+                if (subStmt) collect(subStmt);
+            }
+        }
+
+        void write(Expr *LHSExpr) {
+            if (DeclRefExpr *declRefExpr = dyn_cast<DeclRefExpr>(LHSExpr->IgnoreParenImpCasts())) {
+                writtenDecls.insert(declRefExpr->getFoundDecl());
+            } else {
+                writesMemory = true;
+            }
+        }
+    };
+
+    void add(Stmt *stmt) {
+        // Literals and sizeof cost nothing to evaluate again
+        Expr *expr = cast<Expr>(stmt)->IgnoreParenImpCasts();
+        if (isa<IntegerLiteral>(expr) || isa<UnaryExprOrTypeTraitExpr>(expr)) return;
+        exprs.insert(stmt);
+    }
+
+    // Whether `stmt` is invariant, collecting its maximal invariant subexpressions when it isn't
+    bool collect(Stmt *stmt, const Effects &effects) {
+        bool childrenInvariant = true;
+        llvm::SmallVector<Stmt *, 4> invariantChildren;
+        for (Stmt *subStmt: stmt->children()) {
+            if (subStmt == nullptr) continue;
+            if (collect(subStmt, effects)) {
+                invariantChildren.push_back(subStmt);
+            } else {
+                childrenInvariant = false;
+            }
+        }
+        if (childrenInvariant && isInvariantNode(stmt, effects)) return true;
+        for (Stmt *subStmt: invariantChildren) add(subStmt);
+        return false;
+    }
+
+    // Whether evaluating `stmt` itself is free of side effects and yields the same value in every iteration
+    static bool isInvariantNode(Stmt *stmt, const Effects &effects) {
+        Expr *expr = dyn_cast<Expr>(stmt);
+        if (expr == nullptr) return false;
+        auto exprType = expr->getType();
+        if (exprType->isFunctionType() || exprType->isFunctionPointerType()) return false;
+
+        if (isa<IntegerLiteral>(expr) || isa<UnaryExprOrTypeTraitExpr>(expr) ||
+            isa<ParenExpr>(expr) || isa<ArraySubscriptExpr>(expr)) {
+            return true;
+        } else if (DeclRefExpr *declRefExpr = dyn_cast<DeclRefExpr>(expr)) {
+            VarDecl *varDecl = dyn_cast<VarDecl>(declRefExpr->getFoundDecl());
+            if (varDecl == nullptr || effects.writtenDecls.count(varDecl)) return false;
+            return !(varDecl->hasGlobalStorage() && effects.writesGlobals);
+        } else if (CastExpr *castExpr = dyn_cast<CastExpr>(expr)) {
+            // Loading an array element or dereferencing a pointer
+            bool isLoad = castExpr->getCastKind() == clang::CK_LValueToRValue &&
+                          !isa<DeclRefExpr>(castExpr->getSubExpr()->IgnoreParens());
+            return !(isLoad && effects.writesMemory);
+        } else if (BinaryOperator *bop = dyn_cast<BinaryOperator>(expr)) {
+            return !bop->isAssignmentOp();
+        } else if (UnaryOperator *uop = dyn_cast<UnaryOperator>(expr)) {
+            return !uop->isIncrementDecrementOp();
+        }
+        return false;
+    }
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+#include "clang/AST/Decl.h"
+#include "clang/AST/Stmt.h"
+#include "clang/Basic/SourceManager.h"
+
+using namespace clang;
+
+// Statistical profiler of the guest program. A SIGPROF timer snapshots the function and PC of every frame of the
+// interpreter stack into a lock-free single producer, single consumer ring buffer. The interpreter drains it at safe
+// points, and at exit the samples are written as folded stacks, i.e. `main:12;fib:5;fib:7 42` per line.
+template<typename Frame>
+class SamplingProfiler {
+public:
+    static constexpr uint32_t MAX_DEPTH = 64;   // Deeper stacks keep their innermost frames
+    static constexpr uint32_t RING_SIZE = 256;  // Samples, a power of 2
+
+private:
+    struct Sample {
+        uint32_t depth;
+        const FunctionDecl *functions[MAX_DEPTH];
+        const Stmt *pcs[MAX_DEPTH];
+    };
+
+    typedef std::vector<std::pair<const FunctionDecl *, const Stmt *>> RawStack;
+
+    static SamplingProfiler *active;    // Receiver of SIGPROF
+
+    FILE *fp;
+    const std::vector<Frame> *stack;
+    std::unique_ptr<Sample[]> ring;
+    std::atomic<uint32_t> head;         // Written by the signal handler only
+    std::atomic<uint32_t> tail;         // Written by `drain` only
+    std::atomic<uint64_t> dropped;      // Samples lost to a full ring
+    std::map<RawStack, uint64_t> stacks;
+
+    static void onSignal(int) {
+        if (active) active->sample();
+    }
+
+    // Runs in the signal handler: no allocation, no locks. Frames are constructed before `dStack` grows and
+    // destroyed after it shrinks, so the frames below `size()` are always readable.
+    void sample() {
+        uint32_t sampleHead = head.load(std::memory_order_relaxed);
+        if (sampleHead - tail.load(std::memory_order_acquire) == RING_SIZE) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Sample &slot = ring[sampleHead & (RING_SIZE - 1)];
+        size_t size = stack->size(), begin = size > MAX_DEPTH ? size - MAX_DEPTH : 0;
+        uint32_t depth = 0;
+        for (size_t i = begin; i < size; i++, depth++) {
+            slot.functions[depth] = (*stack)[i].getFunction();
+            slot.pcs[depth] = (*stack)[i].getPC();
+        }
+        slot.depth = depth;
+        head.store(sampleHead + 1, std::memory_order_release);
+    }
+
+    std::string getFrameName(SourceManager &sourceManager, const FunctionDecl *function, const Stmt *pc) {
+        std::string name = function ? function->getNameAsString() : "<init>";
+        if (pc) {
+            PresumedLoc loc = sourceManager.getPresumedLoc(pc->getBeginLoc());
+            if (loc.isValid()) name += ":" + std::to_string(loc.getLine());
+        }
+        return name;
+    }
+
+public:
+    SamplingProfiler() : fp(nullptr), stack(nullptr), ring(), head(0), tail(0), dropped(0), stacks() {}
+
+    ~SamplingProfiler() {
+        stop();
+        if (fp) fclose(fp);
+    }
+
+    SamplingProfiler(const SamplingProfiler &) = delete;
+
+    SamplingProfiler &operator=(const SamplingProfiler &) = delete;
+
+    // Start sampling `frameStack` `frequency` times per second of CPU time
+    bool open(const char *path, const std::vector<Frame> *frameStack, uint64_t frequency) {
+        fp = fopen(path, "w");
+        if (fp == nullptr) return false;
+        stack = frameStack;
+        ring.reset(new Sample[RING_SIZE]);
+        active = this;
+
+        struct sigaction action = {};
+        action.sa_handler = onSignal;
+        action.sa_flags = SA_RESTART; // Don't fail `scanf` of GET()
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+
+        uint64_t interval = 1000000 / (frequency ? frequency : 1);
+        struct itimerval timer = {};
+        timer.it_interval.tv_sec = timer.it_value.tv_sec = interval / 1000000;
+        timer.it_interval.tv_usec = timer.it_value.tv_usec = interval % 1000000;
+        if (interval == 0) timer.it_interval.tv_usec = timer.it_value.tv_usec = 1;
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        return true;
+    }
+
+    bool isOpen() const {
+        return fp != nullptr;
+    }
+
+    // Whether the ring is half full and should be drained
+    bool hasBacklog() const {
+        return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed) >= RING_SIZE / 2;
+    }
+
+    // Move the pending samples out of the ring
+    void drain() {
+        uint32_t drainTail = tail.load(std::memory_order_relaxed);
+        uint32_t drainHead = head.load(std::memory_order_acquire);
+        for (; drainTail != drainHead; drainTail++) {
+            const Sample &slot = ring[drainTail & (RING_SIZE - 1)];
+            RawStack rawStack(slot.depth);
+            for (uint32_t i = 0; i < slot.depth; i++) rawStack[i] = std::make_pair(slot.functions[i], slot.pcs[i]);
+            stacks[rawStack]++;
+        }
+        tail.store(drainTail, std::memory_order_release);
+    }
+
+    void stop() {
+        if (active != this) return;
+        struct itimerval timer = {};
+        setitimer(ITIMER_PROF, &timer, nullptr);
+        signal(SIGPROF, SIG_IGN);
+        active = nullptr;
+    }
+
+    // Stop sampling and write the folded stacks, outermost frame first
+    void write(SourceManager &sourceManager) {
+        stop();
+        drain();
+        std::map<std::string, uint64_t> folded;
+        uint64_t sampleCount = 0;
+        for (auto &item: stacks) {
+            if (item.first.empty()) continue;
+            std::string line;
+            for (auto &frame: item.first) {
+                if (!line.empty()) line += ';';
+                line += getFrameName(sourceManager, frame.first, frame.second);
+            }
+            folded[line] += item.second;
+            sampleCount += item.second;
+        }
+        for (auto &item: folded) {
+            fprintf(fp, "%s %llu\n", item.first.c_str(), static_cast<unsigned long long>(item.second));
+        }
+        fclose(fp);
+        fp = nullptr;
+        uint64_t droppedCount = dropped.load(std::memory_order_relaxed);
+        if (droppedCount) {
+            fprintf(stderr, "[!] Profiler dropped %llu of %llu samples.\n",
+                    static_cast<unsigned long long>(droppedCount),
+                    static_cast<unsigned long long>(droppedCount + sampleCount));
+        }
+    }
+};
+
+template<typename Frame>
+SamplingProfiler<Frame> *SamplingProfiler<Frame>::active = nullptr;
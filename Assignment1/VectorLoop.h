@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "clang/AST/Expr.h"
+#include "clang/AST/Stmt.h"
+
+using namespace clang;
+
+// Counted loop `for (i = ...; i < n; i++) body` whose body is a single element-wise statement over int arrays:
+//   MAP:    a[i] = b[i] op c[i], where every operand besides `a[i]` may also be a loop invariant scalar
+//   REDUCE: s = s + a[i]
+struct CountedLoop {
+    enum Kind {
+        NONE, // Not recognized, execute normally
+        MAP,
+        REDUCE
+    };
+    enum Op {
+        COPY,
+        ADD,
+        SUB,
+        MUL
+    };
+
+    // An array element `base[i]` or a scalar (variable or literal) which is not written by the loop
+    struct Operand {
+        Decl *arrayBase;
+        Expr *scalar;
+
+        Operand() : arrayBase(nullptr), scalar(nullptr) {}
+
+        bool isArray() const { return arrayBase != nullptr; }
+    };
+
+    Kind kind;
+    Op op;
+    Decl *indexVar;
+    Expr *bound;        // `n`, a variable or literal
+    Decl *accumulator;  // `s` of REDUCE
+    Operand dst, lhs, rhs;
+
+    CountedLoop() : kind(NONE), op(COPY), indexVar(nullptr), bound(nullptr), accumulator(nullptr) {}
+
+    // Recognize the loop shape, leaving `kind` as NONE when anything doesn't fit
+    static CountedLoop match(ForStmt *forStmt) {
+        CountedLoop loop;
+        if (!forStmt->getInit() || !forStmt->getCond() || !forStmt->getInc()) return loop;
+
+        // Induction variable and bound from `i < n`
+        BinaryOperator *cond = dyn_cast<BinaryOperator>(forStmt->getCond()->IgnoreParenImpCasts());
+        if (!cond || cond->getOpcode() != BO_LT) return loop;
+        Decl *indexVar = getIntVar(cond->getLHS());
+        if (!indexVar || !isScalar(cond->getRHS(), indexVar)) return loop;
+
+        // Initialization must write `i`, increment must be `i++`, `++i` or `i = i + 1`
+        if (!initializes(forStmt->getInit(), indexVar) || !isUnitIncrement(forStmt->getInc(), indexVar)) return loop;
+
+        // Single assignment body
+        Stmt *body = forStmt->getBody();
+        if (CompoundStmt *block = dyn_cast<CompoundStmt>(body)) {
+            if (block->size() != 1) return loop;
+            body = block->body_front();
+        }
+        BinaryOperator *assign = dyn_cast<BinaryOperator>(body);
+        if (!assign || assign->getOpcode() != BO_Assign || !assign->getType()->isIntegerType()) return loop;
+
+        loop.indexVar = indexVar;
+        loop.bound = cond->getRHS()->IgnoreParenImpCasts();
+
+        Expr *RHSExpr = assign->getRHS()->IgnoreParenImpCasts();
+        if (ArraySubscriptExpr *dstElem = dyn_cast<ArraySubscriptExpr>(assign->getLHS()->IgnoreParenImpCasts())) {
+            if (!matchOperand(dstElem, indexVar, &loop.dst) || !loop.dst.isArray()) return loop;
+            if (matchOperand(RHSExpr, indexVar, &loop.lhs)) {
+                loop.op = COPY;
+                loop.rhs = loop.lhs;
+            } else {
+                BinaryOperator *bop = dyn_cast<BinaryOperator>(RHSExpr);
+                if (!bop || !matchOp(bop, &loop.op) ||
+                    !matchOperand(bop->getLHS(), indexVar, &loop.lhs) ||
+                    !matchOperand(bop->getRHS(), indexVar, &loop.rhs))
+                    return loop;
+            }
+            loop.kind = MAP;
+        } else if (Decl *accumulator = getIntVar(assign->getLHS())) {
+            // s = s + a[i] or s = a[i] + s
+            BinaryOperator *bop = dyn_cast<BinaryOperator>(RHSExpr);
+            if (accumulator == indexVar || accumulator == getIntVar(loop.bound)) return loop;
+            if (!bop || !matchOp(bop, &loop.op) || loop.op != ADD) return loop;
+            Expr *elemExpr;
+            if (getIntVar(bop->getLHS()) == accumulator) {
+                elemExpr = bop->getRHS();
+            } else if (getIntVar(bop->getRHS()) == accumulator) {
+                elemExpr = bop->getLHS();
+            } else {
+                return loop;
+            }
+            if (!matchOperand(elemExpr, indexVar, &loop.lhs) || !loop.lhs.isArray()) return loop;
+            loop.accumulator = accumulator;
+            loop.kind = REDUCE;
+        }
+        return loop;
+    }
+
+private:
+    // The int variable referenced by `expr`
+    static Decl *getIntVar(Expr *expr) {
+        DeclRefExpr *declRefExpr = dyn_cast<DeclRefExpr>(expr->IgnoreParenImpCasts());
+        if (!declRefExpr) return nullptr;
+        VarDecl *varDecl = dyn_cast<VarDecl>(declRefExpr->getFoundDecl());
+        if (!varDecl || !varDecl->getType()->isIntegerType()) return nullptr;
+        return varDecl;
+    }
+
+    static bool isScalar(Expr *expr, Decl *indexVar) {
+        expr = expr->IgnoreParenImpCasts();
+        if (isa<IntegerLiteral>(expr)) return true;
+        Decl *var = getIntVar(expr);
+        return var != nullptr && var != indexVar;
+    }
+
+    static bool initializes(Stmt *init, Decl *indexVar) {
+        if (BinaryOperator *bop = dyn_cast<BinaryOperator>(init)) {
+            return bop->getOpcode() == BO_Assign && getIntVar(bop->getLHS()) == indexVar;
+        }
+        if (DeclStmt *declStmt = dyn_cast<DeclStmt>(init)) {
+            return declStmt->isSingleDecl() && declStmt->getSingleDecl() == indexVar;
+        }
+        return false;
+    }
+
+    static bool isUnitIncrement(Expr *inc, Decl *indexVar) {
+        if (UnaryOperator *uop = dyn_cast<UnaryOperator>(inc)) {
+            return (uop->getOpcode() == UO_PostInc || uop->getOpcode() == UO_PreInc) &&
+                   getIntVar(uop->getSubExpr()) == indexVar;
+        }
+        if (BinaryOperator *bop = dyn_cast<BinaryOperator>(inc)) {
+            if (bop->getOpcode() != BO_Assign || getIntVar(bop->getLHS()) != indexVar) return false;
+            BinaryOperator *add = dyn_cast<BinaryOperator>(bop->getRHS()->IgnoreParenImpCasts());
+            if (!add || add->getOpcode() != BO_Add || getIntVar(add->getLHS()) != indexVar) return false;
+            IntegerLiteral *step = dyn_cast<IntegerLiteral>(add->getRHS()->IgnoreParenImpCasts());
+            return step && step->getValue() == 1;
+        }
+        return false;
+    }
+
+    static bool matchOp(BinaryOperator *bop, Op *op) {
+        if (!bop->getType()->isIntegerType()) return false;
+        switch (bop->getOpcode()) {
+            case BO_Add:
+                *op = ADD;
+                return true;
+            case BO_Sub:
+                *op = SUB;
+                return true;
+            case BO_Mul:
+                *op = MUL;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // `base[i]` with `base` an int array or pointer variable, or a scalar
+    static bool matchOperand(Expr *expr, Decl *indexVar, Operand *operand) {
+        expr = expr->IgnoreParenImpCasts();
+        if (ArraySubscriptExpr *elem = dyn_cast<ArraySubscriptExpr>(expr)) {
+            if (!elem->getType()->isIntegerType() || getIntVar(elem->getIdx()) != indexVar) return false;
+            DeclRefExpr *baseRef = dyn_cast<DeclRefExpr>(elem->getBase()->IgnoreParenImpCasts());
+            if (!baseRef) return false;
+            auto baseType = baseRef->getType();
+            if (!baseType->isConstantArrayType() && !baseType->isPointerType()) return false;
+            operand->arrayBase = baseRef->getFoundDecl();
+            return true;
+        }
+        if (isScalar(expr, indexVar)) {
+            operand->scalar = expr;
+            return true;
+        }
+        return false;
+    }
+};
+
+// SIMD host kernels over the backing memory of heap chunks, 4 int lanes per step.
+// Arithmetic is done on unsigned lanes to wrap around like the scalar interpreter does.
+namespace VectorKernel {
+    typedef uint32_t v4su __attribute__((vector_size(16)));
+
+    static inline v4su load(const int *ptr) {
+        v4su vec;
+        memcpy(&vec, ptr, sizeof(vec));
+        return vec;
+    }
+
+    static inline void store(int *ptr, v4su vec) {
+        memcpy(ptr, &vec, sizeof(vec));
+    }
+
+    static inline v4su splat(int scalar) {
+        uint32_t lane = static_cast<uint32_t>(scalar);
+        return v4su{lane, lane, lane, lane};
+    }
+
+    static inline uint32_t apply(CountedLoop::Op op, uint32_t lhs, uint32_t rhs) {
+        switch (op) {
+            case CountedLoop::ADD:
+                return lhs + rhs;
+            case CountedLoop::SUB:
+                return lhs - rhs;
+            case CountedLoop::MUL:
+                return lhs * rhs;
+            default:
+                return lhs;
+        }
+    }
+
+    template<CountedLoop::Op op>
+    static void elementwise(int *dst, const int *lhs, int lhsScalar, const int *rhs, int rhsScalar, uint32_t count) {
+        v4su lhsSplat = splat(lhsScalar), rhsSplat = splat(rhsScalar);
+        uint32_t k = 0;
+        for (; k + 4 <= count; k += 4) {
+            v4su lhsVec = lhs ? load(lhs + k) : lhsSplat;
+            v4su rhsVec = rhs ? load(rhs + k) : rhsSplat;
+            switch (op) {
+                case CountedLoop::COPY:
+                    store(dst + k, lhsVec);
+                    break;
+                case CountedLoop::ADD:
+                    store(dst + k, lhsVec + rhsVec);
+                    break;
+                case CountedLoop::SUB:
+                    store(dst + k, lhsVec - rhsVec);
+                    break;
+                case CountedLoop::MUL:
+                    store(dst + k, lhsVec * rhsVec);
+                    break;
+            }
+        }
+        for (; k < count; k++) { // Tail
+            uint32_t lhsVal = lhs ? lhs[k] : lhsScalar, rhsVal = rhs ? rhs[k] : rhsScalar;
+            dst[k] = static_cast<int>(apply(op, lhsVal, rhsVal));
+        }
+    }
+
+    // dst[k] = lhs[k] op rhs[k], a null `lhs` or `rhs` stands for its broadcast scalar
+    static void elementwise(CountedLoop::Op op, int *dst, const int *lhs, int lhsScalar, const int *rhs, int rhsScalar,
+                    uint32_t count) {
+        switch (op) {
+            case CountedLoop::COPY:
+                elementwise<CountedLoop::COPY>(dst, lhs, lhsScalar, rhs, rhsScalar, count);
+                break;
+            case CountedLoop::ADD:
+                elementwise<CountedLoop::ADD>(dst, lhs, lhsScalar, rhs, rhsScalar, count);
+                break;
+            case CountedLoop::SUB:
+                elementwise<CountedLoop::SUB>(dst, lhs, lhsScalar, rhs, rhsScalar, count);
+                break;
+            case CountedLoop::MUL:
+                elementwise<CountedLoop::MUL>(dst, lhs, lhsScalar, rhs, rhsScalar, count);
+                break;
+        }
+    }
+
+    // init + src[0] + ... + src[count - 1]
+    static int sum(int init, const int *src, uint32_t count) {
+        v4su acc = splat(0);
+        uint32_t k = 0;
+        for (; k + 4 <= count; k += 4) {
+            acc += load(src + k);
+        }
+        uint32_t result = static_cast<uint32_t>(init) + acc[0] + acc[1] + acc[2] + acc[3];
+        for (; k < count; k++) { // Tail
+            result += static_cast<uint32_t>(src[k]);
+        }
+        return static_cast<int>(result);
+    }
+}
@@ -0,0 +1,143 @@
+// Microbenchmarks of the Heap, StackFrame and StaticStorage in Environment.h, reporting ns per operation.
+// Usage: environment-benchmark [scale], where scale multiplies the operation counts (1 by default).
+
+#include <chrono>
+#include <random>
+#include <string>
+
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+
+#include "Environment.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static volatile int sink; // Keeps results alive
+
+static void report(const char *name, uint64_t ops, Clock::time_point start) {
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    printf("%-32s %12llu ops %10.2f ns/op\n", name, static_cast<unsigned long long>(ops), elapsed / ops);
+}
+
+// Release a random live chunk and allocate a new one, keeping `liveCount` chunks alive
+static void benchAllocFree(uint64_t ops, uint_t liveCount) {
+    Heap heap;
+    std::mt19937 rng(1);
+    vector<int> live;
+    for (uint_t i = 0; i < liveCount; i++) live.push_back(heap.allocate(rng() % 64 + 1));
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        int &slot = live[rng() % liveCount];
+        heap.release(slot);
+        slot = heap.allocate(rng() % 64 + 1);
+    }
+    report(("heap alloc/free, " + std::to_string(liveCount) + " live").c_str(), ops, start);
+}
+
+// Random set followed by get of int elements spread over `chunkCount` chunks
+static void benchGetSet(uint64_t ops, uint_t chunkCount) {
+    const uint_t chunkInts = 16;
+    Heap heap;
+    std::mt19937 rng(2);
+    vector<int> chunks;
+    for (uint_t i = 0; i < chunkCount; i++) chunks.push_back(heap.allocate(chunkInts * sizeof(int)));
+    int sum = 0;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        int addr = chunks[rng() % chunkCount] + (rng() % chunkInts) * sizeof(int);
+        heap.set(addr, i);
+        sum += heap.get(addr);
+    }
+    sink = sum;
+    report(("heap get+set, " + std::to_string(chunkCount) + " chunks").c_str(), ops, start);
+}
+
+// Push frames binding `paramCount` parameters each down to `depth`, then pop them all
+static void benchFrames(uint64_t ops, uint_t depth, const vector<Decl *> &decls) {
+    const uint_t paramCount = 4;
+    vector<StackFrame> stack;
+    stack.reserve(depth); // Like `Environment::init`, frames are never moved
+    int sum = 0;
+    uint64_t rounds = ops / depth;
+    Clock::time_point start = Clock::now();
+    for (uint64_t round = 0; round < rounds; round++) {
+        for (uint_t level = 0; level < depth; level++) {
+            stack.emplace_back();
+            for (uint_t i = 0; i < paramCount; i++) stack.back().bindDecl(decls[i], level + i);
+            sum += stack.back().getDeclVal(decls[level % paramCount]);
+        }
+        while (!stack.empty()) stack.pop_back();
+    }
+    sink = sum;
+    report(("frame push/pop, depth " + std::to_string(depth)).c_str(), rounds * depth, start);
+}
+
+// Random variable and expression value lookups in a frame binding all of `decls`
+static void benchFrameLookup(uint64_t ops, const vector<Decl *> &decls) {
+    StackFrame frame;
+    std::mt19937 rng(3);
+    vector<Stmt *> exprs; // Only used as keys, never dereferenced
+    for (uint_t i = 0; i < decls.size(); i++) {
+        frame.bindDecl(decls[i], i);
+        exprs.push_back(reinterpret_cast<Stmt *>(static_cast<uintptr_t>(i + 1) << 4));
+        frame.bindStmt(exprs.back(), i);
+    }
+    int sum = 0;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        sum += frame.getDeclVal(decls[rng() % decls.size()]);
+    }
+    report(("frame decl lookup, " + std::to_string(decls.size()) + " vars").c_str(), ops, start);
+    start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        Stmt *expr = exprs[rng() % exprs.size()];
+        frame.bindStmt(expr, i);
+        sum += frame.getStmtVal(expr);
+    }
+    report(("frame expr bind+get, " + std::to_string(exprs.size()) + " exprs").c_str(), ops, start);
+    sink = sum;
+}
+
+// Random global variable get and set
+static void benchStaticStorage(uint64_t ops, const vector<Decl *> &decls) {
+    StaticStorage storage;
+    std::mt19937 rng(4);
+    for (uint_t i = 0; i < decls.size(); i++) storage.set(decls[i], i);
+    int sum = 0;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < ops; i++) {
+        Decl *decl = decls[rng() % decls.size()];
+        storage.set(decl, i);
+        sum += storage.get(decl);
+    }
+    sink = sum;
+    report(("static get+set, " + std::to_string(decls.size()) + " globals").c_str(), ops, start);
+}
+
+int main(int argc, char **argv) {
+    uint64_t scale = argc > 1 ? strtoull(argv[1], nullptr, 0) : 1;
+    uint64_t ops = 1000000 * (scale ? scale : 1);
+
+    // Real declarations, since frames inspect the type of their variables when destroyed
+    const uint_t declCount = 4096;
+    std::string code;
+    for (uint_t i = 0; i < declCount; i++) code += "int v" + std::to_string(i) + ";\n";
+    std::unique_ptr<ASTUnit> unit = tooling::buildASTFromCode(code, "benchmark.c");
+    vector<Decl *> decls;
+    for (Decl *decl: unit->getASTContext().getTranslationUnitDecl()->decls()) {
+        if (isa<VarDecl>(decl)) decls.push_back(decl);
+    }
+    vector<Decl *> fewDecls(decls.begin(), decls.begin() + 16);
+
+    benchAllocFree(ops / 10, 64);
+    benchAllocFree(ops / 100, 1024);
+    benchGetSet(ops, 64);
+    benchGetSet(ops / 10, 4096);
+    benchFrames(ops, 16, decls);
+    benchFrames(ops, 1024, decls);
+    benchFrameLookup(ops, fewDecls);
+    benchFrameLookup(ops, decls);
+    benchStaticStorage(ops, fewDecls);
+    benchStaticStorage(ops, decls);
+    return 0;
+}
@@ -5,13 +5,15 @@ import os
 
 MAX_TESTCASE_ID = 29
 TOTAL_TESTCASE_NUMBER = MAX_TESTCASE_ID + 1
+# Statement budget handed to the interpreter, stops runaway testcases before `timeout` has to
+INTERPRETER_FUEL = 10000000
 
 passed_testcase = 0
 
 for i in range(0, MAX_TESTCASE_ID + 1):
     os.system("gcc lib.c test%02d.c -o test%02d.out" % (i, i))
     os.system("./test%02d.out > std%02d.txt" % (i, i))
-    os.system("timeout 1 ./ast-interpreter-docker test%02d.c > ans%02d.txt" % (i, i))
+    os.system("ASSIGNMENT_FUEL=%d timeout 1 ./ast-interpreter-docker test%02d.c > ans%02d.txt" % (INTERPRETER_FUEL, i, i))
     ret = os.system("diff std%02d.txt ans%02d.txt" % (i, i))
     if ret == 0:
         print("Testcase %02d Passed!" % i)
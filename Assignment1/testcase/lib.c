@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 int GET() {
     int v;
@@ -15,4 +16,24 @@ void FREE(void *addr) {
 void PRINT(int v) {
     printf("%d\n", v);
 }
-
+void FILL(int *dst, int val, int count) {
+    for (int i = 0; i < count; i++) dst[i] = val;
+}
+void COPY(int *dst, int *src, int count) {
+    memmove(dst, src, count * sizeof(int));
+}
+int COMPARE(int *lhs, int *rhs, int count) {
+    for (int i = 0; i < count; i++) {
+        if (lhs[i] != rhs[i]) return lhs[i] < rhs[i] ? -1 : 1;
+    }
+    return 0;
+}
+int ABS(int v) {
+    return v < 0 ? -v : v;
+}
+int MIN(int a, int b) {
+    return a < b ? a : b;
+}
+int MAX(int a, int b) {
+    return a > b ? a : b;
+}
@@ -0,0 +1,36 @@
+#!/usr/bin/env python3
+# coding = utf-8
+
+# Decode a trace written with ASSIGNMENT_TRACE into one statement ID per line, ready to be diffed.
+
+import sys
+
+MAGIC = b"ASTTRC1\n"
+
+if len(sys.argv) != 2:
+    print("Usage: %s <trace>" % sys.argv[0])
+    sys.exit(1)
+
+with open(sys.argv[1], "rb") as f:
+    data = f.read()
+
+if not data.startswith(MAGIC):
+    print("%s is not an interpreter trace." % sys.argv[1])
+    sys.exit(1)
+
+last_id = 0
+value = 0
+shift = 0
+out = []
+for byte in data[len(MAGIC):]:
+    value |= (byte & 0x7f) << shift
+    shift += 7
+    if byte & 0x80:
+        continue
+    delta = (value >> 1) ^ -(value & 1)  # Undo zigzag encoding
+    last_id += delta
+    out.append("%d\n" % last_id)
+    value = 0
+    shift = 0
+
+sys.stdout.write("".join(out))
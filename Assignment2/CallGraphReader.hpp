@@ -0,0 +1,205 @@
+#ifndef ASSIGN2_CALL_GRAPH_READER_H
+#define ASSIGN2_CALL_GRAPH_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary call graph written by `llvmassignment -export-callgraph`, laid out to be used in place once mapped.
+// All fields are little-endian 32 bit words, every array starts 4 byte aligned:
+//
+//   CallGraphHeader
+//   functionNames[functionCount]   Offsets of NUL-terminated names into `strings`
+//   fileNames[fileCount]           Offsets of NUL-terminated names into `strings`
+//   callers[callSiteCount]         Function index of the function containing each callsite
+//   files[callSiteCount]           File index of each callsite
+//   lines[callSiteCount]           Source line of each callsite, 0 when unknown
+//   calleeBegins[callSiteCount+1]  Callees of callsite c are callees[calleeBegins[c] .. calleeBegins[c+1])
+//   callees[edgeCount]             Function indices, ascending per callsite
+//   strings[stringsSize]
+//
+// This header needs neither LLVM nor the analysis, so tools consuming call graphs can include it alone.
+struct CallGraphHeader {
+    static const uint32_t MAGIC = 0x47434641; // "AFCG"
+    static const uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t functionCount;
+    uint32_t fileCount;
+    uint32_t callSiteCount;
+    uint32_t edgeCount;
+    uint32_t stringsSize;
+    uint32_t reserved;
+};
+
+// Read-only view of a call graph file. Opening validates every offset and index once, so the accessors don't check
+// anything afterwards.
+class CallGraphReader {
+    const uint32_t *functionNames = nullptr;
+    const uint32_t *fileNames = nullptr;
+    const uint32_t *callers = nullptr;
+    const uint32_t *files = nullptr;
+    const uint32_t *lines = nullptr;
+    const uint32_t *calleeBegins = nullptr;
+    const uint32_t *calleeIds = nullptr;
+    const char *strings = nullptr;
+    CallGraphHeader header{};
+
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+
+    static bool isLittleEndian() {
+        const uint16_t probe = 1;
+        return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+    }
+
+    bool isName(uint32_t offset) const {
+        return offset < header.stringsSize;
+    }
+
+    bool validate() const {
+        for (uint32_t func = 0; func < header.functionCount; func++) {
+            if (!isName(functionNames[func])) return false;
+        }
+        for (uint32_t file = 0; file < header.fileCount; file++) {
+            if (!isName(fileNames[file])) return false;
+        }
+        if (calleeBegins[0] != 0 || calleeBegins[header.callSiteCount] != header.edgeCount) return false;
+        for (uint32_t callSite = 0; callSite < header.callSiteCount; callSite++) {
+            if (callers[callSite] >= header.functionCount || files[callSite] >= header.fileCount) return false;
+            if (calleeBegins[callSite] > calleeBegins[callSite + 1]) return false;
+        }
+        for (uint32_t edge = 0; edge < header.edgeCount; edge++) {
+            if (calleeIds[edge] >= header.functionCount) return false;
+        }
+        // Every name ends before the end of the table
+        return header.stringsSize == 0 || strings[header.stringsSize - 1] == '\0';
+    }
+
+public:
+    // A range of callee function indices
+    struct Callees {
+        const uint32_t *first, *last;
+
+        const uint32_t *begin() const {
+            return first;
+        }
+
+        const uint32_t *end() const {
+            return last;
+        }
+
+        size_t size() const {
+            return last - first;
+        }
+    };
+
+    CallGraphReader() = default;
+    CallGraphReader(const CallGraphReader &) = delete;
+    CallGraphReader &operator=(const CallGraphReader &) = delete;
+
+    ~CallGraphReader() {
+        close();
+    }
+
+    // Use a call graph already in memory, which must be 4 byte aligned and outlive the reader. Return false if it
+    // isn't a valid call graph.
+    bool load(const void *data, size_t size) {
+        if (!isLittleEndian() || reinterpret_cast<uintptr_t>(data) % 4 || size < sizeof(CallGraphHeader)) {
+            return false;
+        }
+        memcpy(&header, data, sizeof(CallGraphHeader));
+        if (header.magic != CallGraphHeader::MAGIC || header.version != CallGraphHeader::VERSION) return false;
+        uint64_t words = uint64_t(header.functionCount) + header.fileCount + 4 * uint64_t(header.callSiteCount) + 1 +
+                         header.edgeCount;
+        if (sizeof(CallGraphHeader) + 4 * words + header.stringsSize != size) return false;
+
+        const uint32_t *cursor = reinterpret_cast<const uint32_t *>(
+                static_cast<const char *>(data) + sizeof(CallGraphHeader));
+        functionNames = cursor;
+        fileNames = functionNames + header.functionCount;
+        callers = fileNames + header.fileCount;
+        files = callers + header.callSiteCount;
+        lines = files + header.callSiteCount;
+        calleeBegins = lines + header.callSiteCount;
+        calleeIds = calleeBegins + header.callSiteCount + 1;
+        strings = reinterpret_cast<const char *>(calleeIds + header.edgeCount);
+        return validate();
+    }
+
+    // Map a call graph file, return false if it can't be read or isn't a valid call graph
+    bool open(const char *path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd == -1) return false;
+        struct stat status;
+        if (fstat(fd, &status) == -1 || status.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        mappingSize = status.st_size;
+        mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            return false;
+        }
+        if (load(mapping, mappingSize)) return true;
+        close();
+        return false;
+    }
+
+    void close() {
+        if (mapping) munmap(mapping, mappingSize);
+        mapping = nullptr;
+        header = CallGraphHeader();
+    }
+
+    uint32_t getFunctionCount() const {
+        return header.functionCount;
+    }
+
+    uint32_t getFileCount() const {
+        return header.fileCount;
+    }
+
+    uint32_t getCallSiteCount() const {
+        return header.callSiteCount;
+    }
+
+    uint32_t getEdgeCount() const {
+        return header.edgeCount;
+    }
+
+    const char *getFunctionName(uint32_t func) const {
+        return strings + functionNames[func];
+    }
+
+    const char *getFileName(uint32_t file) const {
+        return strings + fileNames[file];
+    }
+
+    uint32_t getCaller(uint32_t callSite) const {
+        return callers[callSite];
+    }
+
+    uint32_t getFile(uint32_t callSite) const {
+        return files[callSite];
+    }
+
+    uint32_t getLine(uint32_t callSite) const {
+        return lines[callSite];
+    }
+
+    Callees getCallees(uint32_t callSite) const {
+        return Callees{calleeIds + calleeBegins[callSite], calleeIds + calleeBegins[callSite + 1]};
+    }
+};
+
+#endif
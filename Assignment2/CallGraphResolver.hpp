@@ -0,0 +1,151 @@
+#ifndef ASSIGN2_CALL_GRAPH_RESOLVER_H
+#define ASSIGN2_CALL_GRAPH_RESOLVER_H
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "util.hpp"
+#include "ConstraintGraph.hpp"
+#include "Statistics.hpp"
+
+// Call graph resolution shared by FuncPtrPass, on the IR of a module, and SummaryLinker, on linked summaries.
+// Functions and callsites are dense IDs and function pointers are nodes of a constraint graph. Every callsite is
+// bound to each of its callees once: a direct one right away, an indirect one as its called pointer gains functions
+// whose address is taken and whose signature is the one called. `Derived` provides
+//   void bindCallee(unsigned callId, unsigned calleeId): bind the function pointer arguments and returned value,
+//   unsigned getCalledNode(unsigned callId) and Signature getCallSignature(unsigned callId) of indirect callsites,
+//   llvm::StringRef getFuncName(unsigned funcId),
+// and may hide exploreDemanded() to add facts before every round of the fixpoint.
+template<class Derived, class Signature>
+class CallGraphResolver {
+protected:
+    std::vector<IdSet> callGraphEdge;       // Callsite ID -> callee function IDs
+    std::vector<PointsToSet> boundCallees;  // Callsite ID -> callees whose bindings are made
+    llvm::DenseMap<Signature, PointsToSet> addressTakenFuncs; // Function type -> IDs of functions whose address is taken
+    ConstraintGraph funcPtrGraph;           // Function pointer node -> function IDs, with bindings as copy edges
+    unsigned indirectCallSites = 0;
+    unsigned fixpointRounds = 0;
+    unsigned indirectResolutions = 0;
+
+    explicit CallGraphResolver(bool unify) : funcPtrGraph(unify) {}
+
+    Derived &derived() {
+        return static_cast<Derived &>(*this);
+    }
+
+    void exploreDemanded() {}
+
+    void resizeCallSites(size_t count) {
+        callGraphEdge.resize(count);
+        boundCallees.resize(count);
+    }
+
+    void addAddressTaken(Signature signature, unsigned funcId) {
+        addressTakenFuncs[signature].set(funcId);
+    }
+
+    // Return whether the callee is new
+    bool addDirectCall(unsigned callId, unsigned calledFuncId) {
+        if (!callGraphEdge[callId].insert(calledFuncId)) return false;
+        derived().bindCallee(callId, calledFuncId);
+        return true;
+    }
+
+    // Resolved whenever the called pointer gains values
+    void addIndirectCall(unsigned callId) {
+        indirectCallSites++;
+        funcPtrGraph.watch(derived().getCalledNode(callId), callId);
+    }
+
+    // Add the callees an indirect callsite gained since its last resolution
+    void resolveIndirectCall(unsigned callId) {
+        indirectResolutions++;
+        PointsToSet newCallees; // A copy, binding the callees may grow the solved set
+        newCallees.intersectWithComplement(funcPtrGraph.getPointsTo(derived().getCalledNode(callId)),
+                                           boundCallees[callId]);
+        auto signatureFuncs = addressTakenFuncs.find(derived().getCallSignature(callId));
+        if (signatureFuncs == addressTakenFuncs.end()) return;
+        newCallees &= signatureFuncs->second;
+        boundCallees[callId] |= newCallees;
+        for (unsigned maybeCalleeFunc: newCallees) {
+            callGraphEdge[callId].insert(maybeCalleeFunc); // New, `boundCallees` held all previous callees
+#ifdef ASSIGNMENT_DEBUG_DUMP
+            llvm::StringRef name = derived().getFuncName(maybeCalleeFunc);
+            fprintf(stderr, "\t- Adding new function %.*s to callsite %u.\n",
+                    static_cast<int>(name.size()), name.data(), callId);
+#endif
+            derived().bindCallee(callId, maybeCalleeFunc);
+        }
+    }
+
+    // Every function is an entrypoint, so every callsite added is a root of a single fixpoint. Afterwards a round
+    // only resolves the indirect callsites whose called pointer gained values.
+    void resolveCallGraph() {
+        while (true) {
+            fixpointRounds++;
+#ifdef ASSIGNMENT_DEBUG_DUMP
+            fprintf(stderr, "[*] Building call graph: propagating bindings: loop %u.\n", fixpointRounds);
+#endif
+            derived().exploreDemanded();
+            funcPtrGraph.solve();
+            std::vector<unsigned> changedCalls = funcPtrGraph.takeTriggered();
+            if (changedCalls.empty()) break;
+#ifdef ASSIGNMENT_DEBUG_DUMP
+            fprintf(stderr, "[*] Building call graph: modifying call graph: loop %u.\n", fixpointRounds);
+#endif
+            for (unsigned callId: changedCalls) {
+                resolveIndirectCall(callId);
+            }
+        }
+    }
+
+    // Print the callees of every line as "line : callee, ...", sorted by line then callee name. `locate(callId,
+    // file, line)` returns whether a callsite is printed, and its file as an index into `files`, whose names
+    // prefix the lines as "file:" unless there are none.
+    template<class Locate>
+    void printCallGraph(Locate locate, const std::vector<const std::string *> &files = {}) {
+        std::map<std::pair<unsigned, unsigned>, std::vector<llvm::StringRef>> sortContainer;
+        for (unsigned callId = 0; callId < callGraphEdge.size(); callId++) {
+            if (callGraphEdge[callId].size() == 0) continue;
+            std::pair<unsigned, unsigned> fileLine(0, 0);
+            if (!locate(callId, fileLine.first, fileLine.second)) continue;
+            std::vector<llvm::StringRef> &lineCallees = sortContainer[fileLine];
+            for (unsigned callee: callGraphEdge[callId]) {
+                lineCallees.push_back(derived().getFuncName(callee));
+            }
+        }
+
+        for (auto &lineCalleeNamePairs: sortContainer) {
+            std::vector<llvm::StringRef> &lineCallees = lineCalleeNamePairs.second;
+            std::stable_sort(lineCallees.begin(), lineCallees.end());
+            if (!files.empty()) printf("%s:", files[lineCalleeNamePairs.first.first]->c_str());
+            printf("%u :", lineCalleeNamePairs.first.second);
+            bool flag = true;
+            for (llvm::StringRef maybeCalledFuncName: lineCallees) {
+                printf(", %.*s" + flag, static_cast<int>(maybeCalledFuncName.size()), maybeCalledFuncName.data());
+                flag = false;
+            }
+            printf("\n");
+        }
+    }
+
+    void addStatistics(AnalysisStatistics &statistics) const {
+        uint64_t edges = 0;
+        for (auto &callees: callGraphEdge) edges += callees.size();
+        statistics.setCounter("callSites", callGraphEdge.size());
+        statistics.setCounter("indirectCallSites", indirectCallSites);
+        statistics.setCounter("callGraphEdges", edges);
+        statistics.setCounter("fixpointRounds", fixpointRounds);
+        statistics.setCounter("indirectResolutions", indirectResolutions);
+        statistics.addGraph(funcPtrGraph);
+    }
+};
+
+#endif
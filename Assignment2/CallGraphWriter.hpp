@@ -0,0 +1,83 @@
+#ifndef ASSIGN2_CALL_GRAPH_WRITER_H
+#define ASSIGN2_CALL_GRAPH_WRITER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "CallGraphReader.hpp"
+
+// Builds the arrays of a call graph file (see CallGraphReader.hpp) from dense function IDs, so nothing but the
+// indices is copied. Names are referenced, they must outlive the writer.
+class CallGraphWriter {
+    std::vector<llvm::StringRef> functionNames;
+    std::vector<llvm::StringRef> fileNames;
+    llvm::StringMap<uint32_t> fileIndices;
+    std::vector<uint32_t> callers, files, lines;
+    std::vector<uint32_t> calleeBegins{0};
+    std::vector<uint32_t> callees;
+
+public:
+    // Functions are numbered in the order they are added, which should be the order of the IDs used as callees
+    uint32_t addFunction(llvm::StringRef name) {
+        functionNames.push_back(name);
+        return functionNames.size() - 1;
+    }
+
+    uint32_t getFile(llvm::StringRef name) {
+        auto inserted = fileIndices.insert(std::make_pair(name, static_cast<uint32_t>(fileNames.size())));
+        if (inserted.second) fileNames.push_back(inserted.first->first());
+        return inserted.first->second;
+    }
+
+    template<class CalleeIds>
+    void addCallSite(uint32_t caller, uint32_t file, uint32_t line, const CalleeIds &calleeIds) {
+        callers.push_back(caller);
+        files.push_back(file);
+        lines.push_back(line);
+        size_t begin = callees.size();
+        callees.insert(callees.end(), calleeIds.begin(), calleeIds.end());
+        std::sort(callees.begin() + begin, callees.end());
+        calleeBegins.push_back(callees.size());
+    }
+
+    void write(llvm::raw_ostream &os) const {
+        llvm::support::endian::Writer writer(os, llvm::support::little);
+        uint32_t stringsSize = 0;
+        for (llvm::StringRef name: functionNames) stringsSize += name.size() + 1;
+        for (llvm::StringRef name: fileNames) stringsSize += name.size() + 1;
+
+        writer.write<uint32_t>(CallGraphHeader::MAGIC);
+        writer.write<uint32_t>(CallGraphHeader::VERSION);
+        writer.write<uint32_t>(functionNames.size());
+        writer.write<uint32_t>(fileNames.size());
+        writer.write<uint32_t>(callers.size());
+        writer.write<uint32_t>(callees.size());
+        writer.write<uint32_t>(stringsSize);
+        writer.write<uint32_t>(0);
+
+        uint32_t offset = 0;
+        auto writeOffsets = [&](const std::vector<llvm::StringRef> &names) {
+            for (llvm::StringRef name: names) {
+                writer.write<uint32_t>(offset);
+                offset += name.size() + 1;
+            }
+        };
+        writeOffsets(functionNames);
+        writeOffsets(fileNames);
+        writer.write<uint32_t>(callers);
+        writer.write<uint32_t>(files);
+        writer.write<uint32_t>(lines);
+        writer.write<uint32_t>(calleeBegins);
+        writer.write<uint32_t>(callees);
+        for (llvm::StringRef name: functionNames) os << name << '\0';
+        for (llvm::StringRef name: fileNames) os << name << '\0';
+    }
+};
+
+#endif
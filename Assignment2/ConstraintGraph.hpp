@@ -0,0 +1,277 @@
+#ifndef ASSIGN2_CONSTRAINT_GRAPH_H
+#define ASSIGN2_CONSTRAINT_GRAPH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/SparseBitVector.h>
+
+#include "util.hpp"
+
+// Set of function IDs, unions are word-parallel over the populated 128 bit chunks
+typedef llvm::SparseBitVector<> PointsToSet;
+
+// Inclusion constraints over function pointer nodes: pts(node) contains the function IDs given by `addValue`,
+// and pts(dst) contains pts(src) for every copy edge src -> dst.
+//
+// `solve` first collapses strongly connected components into one representative node with union-find, since
+// all nodes of a cycle end up with the same points-to set. The remaining DAG is swept once in topological
+// order. A node only sends the part of its points-to set its successors haven't received yet (difference
+// propagation), so every function ID travels along every edge at most once.
+//
+// In unification mode (Steensgaard), a copy edge merges its ends right away instead, trading precision for a
+// near-linear run without propagation.
+//
+// Clients `watch` nodes with a token, and `takeTriggered` returns the tokens of nodes whose set grew since, so
+// they only revisit what changed.
+class ConstraintGraph {
+public:
+    // Work done so far, cheap enough to be always counted
+    struct Counters {
+        uint64_t values = 0;       // Function IDs new to a set by `addValue`
+        uint64_t copies = 0;       // Copy edges added, or copies unified
+        uint64_t merges = 0;       // Nodes merged into a representative
+        uint64_t collapses = 0;    // Cycle detection passes
+        uint64_t sweeps = 0;       // Calls of `solve`
+        uint64_t propagations = 0; // Non-empty deltas sent along an edge
+    };
+
+private:
+    std::vector<unsigned> parent;        // Union-find, a node is a representative when it's its own parent
+    std::vector<PointsToSet> pointsTo;   // Valid at representatives
+    std::vector<PointsToSet> propagated; // Part of `pointsTo` already sent to all successors
+    std::vector<IdSet> successors;       // Copy edges at representatives, targets may be stale members
+    std::vector<unsigned> topoOrder;     // Representatives, sources first
+    bool unify;                          // Merge the ends of copy edges instead of adding edges
+    bool edgesChanged;                   // Cycles and order must be recomputed
+    std::vector<llvm::SmallVector<unsigned, 1>> watchers; // Tokens at representatives
+    std::vector<bool> dirty;             // `pointsTo` grew since the last `takeTriggered`
+    std::vector<unsigned> dirtyNodes;
+    Counters counters;
+
+    // Visit state of the iterative Tarjan's algorithm
+    struct TarjanState {
+        std::vector<unsigned> index, lowLink;
+        std::vector<bool> onStack;
+        std::vector<unsigned> stack;
+        std::vector<std::pair<unsigned, size_t>> callStack; // Node and next successor position
+        unsigned nextIndex;
+    };
+
+    void grow(unsigned node) {
+        if (node < parent.size()) return;
+        unsigned oldSize = parent.size();
+        parent.resize(node + 1);
+        for (unsigned i = oldSize; i <= node; i++) parent[i] = i;
+        pointsTo.resize(node + 1);
+        propagated.resize(node + 1);
+        successors.resize(node + 1);
+        watchers.resize(node + 1);
+        dirty.resize(node + 1);
+    }
+
+    void markChanged(unsigned node) {
+        if (dirty[node]) return;
+        dirty[node] = true;
+        dirtyNodes.push_back(node);
+    }
+
+    // Merge representative `member` into representative `rep`
+    void merge(unsigned rep, unsigned member) {
+        counters.merges++;
+        parent[member] = rep;
+        pointsTo[rep] |= pointsTo[member];
+        successors[rep].insert(successors[member]);
+        pointsTo[member].clear();
+        propagated[member].clear();
+        successors[member] = IdSet();
+        propagated[rep].clear(); // Successors of `member` haven't seen the points-to set of `rep`
+        // Neither have the watchers of `member`
+        watchers[rep].append(watchers[member].begin(), watchers[member].end());
+        watchers[member].clear();
+        markChanged(rep);
+    }
+
+    // Collapse cycles and order the representatives topologically
+    void collapseCycles() {
+        counters.collapses++;
+        unsigned size = parent.size();
+        TarjanState state;
+        state.index.assign(size, ~0U);
+        state.lowLink.assign(size, 0);
+        state.onStack.assign(size, false);
+        state.nextIndex = 0;
+        topoOrder.clear();
+
+        for (unsigned root = 0; root < size; root++) {
+            if (find(root) != root || state.index[root] != ~0U) continue;
+            visit(root, state);
+        }
+        // Tarjan emits a component after every component it reaches
+        std::reverse(topoOrder.begin(), topoOrder.end());
+    }
+
+    void visit(unsigned root, TarjanState &state) {
+        state.callStack.emplace_back(root, 0);
+        state.index[root] = state.lowLink[root] = state.nextIndex++;
+        state.stack.push_back(root);
+        state.onStack[root] = true;
+
+        while (!state.callStack.empty()) {
+            unsigned node = state.callStack.back().first;
+            size_t &position = state.callStack.back().second;
+            if (position < successors[node].size()) {
+                unsigned succ = find(successors[node][position++]);
+                if (state.index[succ] == ~0U) {
+                    state.index[succ] = state.lowLink[succ] = state.nextIndex++;
+                    state.stack.push_back(succ);
+                    state.onStack[succ] = true;
+                    state.callStack.emplace_back(succ, 0); // Invalidates `position`
+                } else if (state.onStack[succ]) {
+                    state.lowLink[node] = std::min(state.lowLink[node], state.index[succ]);
+                }
+                continue;
+            }
+            state.callStack.pop_back();
+            if (!state.callStack.empty()) {
+                unsigned caller = state.callStack.back().first;
+                state.lowLink[caller] = std::min(state.lowLink[caller], state.lowLink[node]);
+            }
+            if (state.lowLink[node] != state.index[node]) continue;
+            // `node` is the root of a component, merge the members above it on the stack
+            unsigned member;
+            do {
+                member = state.stack.back();
+                state.stack.pop_back();
+                state.onStack[member] = false;
+                if (member != node) merge(node, member);
+            } while (member != node);
+            topoOrder.push_back(node);
+        }
+    }
+
+public:
+    explicit ConstraintGraph(bool unify = false) : unify(unify), edgesChanged(false) {}
+
+    unsigned find(unsigned node) {
+        grow(node);
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]]; // Path halving
+            node = parent[node];
+        }
+        return node;
+    }
+
+    // Return whether `funcId` is new to pts(node)
+    bool addValue(unsigned node, unsigned funcId) {
+        node = find(node);
+        if (!pointsTo[node].test_and_set(funcId)) return false;
+        counters.values++;
+        markChanged(node);
+        return true;
+    }
+
+    // Add edge src -> dst, return whether it is new. When unifying, return whether src and dst were apart.
+    bool addCopy(unsigned src, unsigned dst) {
+        grow(std::max(src, dst));
+        src = find(src);
+        dst = find(dst);
+        if (src == dst) return false;
+        if (unify) {
+            counters.copies++;
+            merge(dst, src);
+            return true;
+        }
+        if (!successors[src].insert(dst)) return false;
+        counters.copies++;
+        // A new edge needs the whole set of its source, not only the unpropagated part
+        if (pointsTo[dst] |= pointsTo[src]) markChanged(dst);
+        edgesChanged = true;
+        return true;
+    }
+
+    const PointsToSet &getPointsTo(unsigned node) {
+        return pointsTo[find(node)];
+    }
+
+    // Report `token` from `takeTriggered` whenever pts(node) grows, starting with its current set
+    void watch(unsigned node, unsigned token) {
+        node = find(node);
+        watchers[node].push_back(token);
+        markChanged(node);
+    }
+
+    // Tokens watching a set that grew since the last call, each reported once
+    std::vector<unsigned> takeTriggered() {
+        std::vector<unsigned> tokens;
+        for (unsigned node: dirtyNodes) {
+            dirty[node] = false;
+            if (find(node) != node) continue; // Merged, its representative is dirty too
+            tokens.insert(tokens.end(), watchers[node].begin(), watchers[node].end());
+        }
+        dirtyNodes.clear();
+        return tokens;
+    }
+
+    unsigned getNodeCount() const {
+        return parent.size();
+    }
+
+    const Counters &getCounters() const {
+        return counters;
+    }
+
+    // Representatives and the copy edges between them, without the ones turned into self loops by merges
+    std::pair<unsigned, uint64_t> getRepresentativeCounts() const {
+        unsigned representatives = 0;
+        uint64_t edges = 0;
+        for (unsigned node = 0; node < parent.size(); node++) {
+            if (parent[node] != node) continue;
+            representatives++;
+            for (unsigned succ: successors[node]) {
+                while (parent[succ] != succ) succ = parent[succ];
+                edges += succ != node;
+            }
+        }
+        return std::make_pair(representatives, edges);
+    }
+
+    // Representatives by points-to set size: bucket 0 counts empty sets, bucket b sizes in [2^(b-1), 2^b)
+    std::vector<uint64_t> getPointsToHistogram() const {
+        std::vector<uint64_t> histogram;
+        for (unsigned node = 0; node < parent.size(); node++) {
+            if (parent[node] != node) continue;
+            unsigned size = pointsTo[node].count(), bucket = 0;
+            while (size >> bucket) bucket++;
+            if (bucket >= histogram.size()) histogram.resize(bucket + 1);
+            histogram[bucket]++;
+        }
+        return histogram;
+    }
+
+    // Propagate until every constraint holds
+    void solve() {
+        counters.sweeps++;
+        if (edgesChanged) {
+            collapseCycles();
+            edgesChanged = false;
+        }
+        PointsToSet delta;
+        for (unsigned node: topoOrder) {
+            if (find(node) != node) continue;
+            delta.intersectWithComplement(pointsTo[node], propagated[node]);
+            if (delta.empty()) continue;
+            for (unsigned succ: successors[node]) {
+                succ = find(succ);
+                if (succ == node) continue;
+                counters.propagations++;
+                if (pointsTo[succ] |= delta) markChanged(succ);
+            }
+            propagated[node] |= delta;
+        }
+    }
+};
+
+#endif
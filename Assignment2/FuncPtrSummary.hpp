@@ -0,0 +1,55 @@
+#ifndef ASSIGN2_FUNC_PTR_SUMMARY_H
+#define ASSIGN2_FUNC_PTR_SUMMARY_H
+
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Instructions.h>
+
+inline bool isFuncPtrType(llvm::Type *type) {
+    auto *pointerType = llvm::dyn_cast<llvm::PointerType>(type);
+    return pointerType && pointerType->getElementType()->isFunctionTy();
+}
+
+// The instructions of a function that function pointer analysis looks at, in program order. Extraction only
+// reads the IR of its own function, so functions can be summarized concurrently.
+struct FuncPtrSummary {
+    struct CallSite {
+        llvm::CallBase *callBase;
+        llvm::Function *calledFunc;                     // nullptr for indirect calls
+        llvm::SmallVector<llvm::Use *, 2> funcPtrArgs;  // Function pointer arguments
+    };
+
+    std::vector<CallSite> callSites;        // Calls of llvm.dbg intrinsics left out
+    std::vector<llvm::PHINode *> funcPtrPhis;
+    llvm::ReturnInst *firstReturn;          // nullptr if the function never returns
+
+    FuncPtrSummary() : firstReturn(nullptr) {}
+
+    void extract(llvm::Function *func) {
+        for (auto &BB: *func) {
+            for (auto &inst: BB) {
+                if (auto *callBase = llvm::dyn_cast<llvm::CallBase>(&inst)) {
+                    llvm::Function *calledFunc = nullptr;
+                    if (!callBase->isIndirectCall()) {
+                        calledFunc = callBase->getCalledFunction();
+                        if (calledFunc->getName().startswith("llvm.dbg")) continue;
+                    }
+                    callSites.push_back(CallSite{callBase, calledFunc, {}});
+                    for (auto &callArgument: callBase->args()) {
+                        if (!isFuncPtrType(callArgument->getType())) continue;
+                        callSites.back().funcPtrArgs.push_back(&callArgument);
+                    }
+                } else if (auto *phiNode = llvm::dyn_cast<llvm::PHINode>(&inst)) {
+                    if (isFuncPtrType(phiNode->getType())) funcPtrPhis.push_back(phiNode);
+                } else if (auto *retInst = llvm::dyn_cast<llvm::ReturnInst>(&inst)) {
+                    if (!firstReturn) firstReturn = retInst;
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -13,6 +13,13 @@
 #include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/InstrTypes.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 
 #include <vector>
 #include <map>
@@ -22,6 +29,13 @@
 #include <algorithm>
 
 #include "util.hpp"
+#include "ConstraintGraph.hpp"
+#include "FuncPtrSummary.hpp"
+#include "ModuleSummary.hpp"
+#include "CallGraphResolver.hpp"
+#include "SummaryLinker.hpp"
+#include "Statistics.hpp"
+#include "CallGraphWriter.hpp"
 
 using namespace llvm;
 using namespace std;
@@ -30,6 +44,8 @@ static ManagedStatic<LLVMContext> GlobalContext;
 
 static LLVMContext &getGlobalContext() { return *GlobalContext; }
 
+static AnalysisStatistics Statistics;
+
 /* In LLVM 5.0, when -O0 passed to clang , the functions generated with clang will
  * have optnone attribute which would lead to some transform passes disabled, like mem2reg.
  */
@@ -48,314 +64,421 @@ struct EnableFunctionOptPass : public FunctionPass {
 
 char EnableFunctionOptPass::ID = 0;
 
-struct FuncPtrPass : public ModulePass {
+static cl::opt<unsigned>
+        ThreadCount("threads",
+                    cl::desc("Threads summarizing functions, 0 for all cores"),
+                    cl::init(0));
+
+static cl::opt<bool>
+        LazyLoad("lazy",
+                 cl::desc("Read function bodies one at a time after the module, with -lines promote to SSA only "
+                          "the functions the query reaches"),
+                 cl::init(false));
+
+static cl::opt<bool>
+        UnifyPointers("unify",
+                      cl::desc("Unify bound function pointers (Steensgaard), faster but less precise"),
+                      cl::init(false));
+
+static cl::list<unsigned>
+        QueryLines("lines",
+                   cl::desc("Only resolve the callsites on these source lines, exploring backward from them"),
+                   cl::CommaSeparated);
+
+static cl::opt<std::string>
+        StatsFile("analysis-stats",
+                  cl::desc("Write phase times and solver counters as JSON to this file, - for stderr"),
+                  cl::value_desc("filename"),
+                  cl::init(""));
+
+static cl::opt<std::string>
+        ExportCallGraph("export-callgraph",
+                        cl::desc("Also write the call graph in binary, see CallGraphReader.hpp"),
+                        cl::value_desc("filename"),
+                        cl::init(""));
+
+struct FuncPtrPass : public ModulePass, public CallGraphResolver<FuncPtrPass, FunctionType *> {
     static char ID; // Pass identification, replacement for typeid
 
-    map<Function *, vector<CallBase *>> callGraphNode;
-    map<CallBase *, vector<Function *>> callGraphEdge;
+    // Dense IDs of function pointer values, functions and callsites
+    ValueNumbering<Value *> ptrIds;
+    ValueNumbering<Function *> funcIds;
+    ValueNumbering<CallBase *> callIds;
 
-    vector<Value *> funcPtr;
-    vector<CallBase *> funcCall;
-    map<Value *, vector<Value *>> funcPtrBind;
-    map<Value *, vector<Function *>> funcPtrValue;
+    vector<IdSet> callGraphNode; // Function ID -> callsite IDs
 
-    map<Function *, Value *> funcRetValue;
+    vector<FuncPtrSummary> summaries;                   // Function ID -> summary
+    vector<bool> summarized;                            // Function ID -> whether its summary is extracted
+    vector<const FuncPtrSummary::CallSite *> callSites; // Callsite ID -> summary entry
 
+    // Demand-driven queries: only the values flowing into the queried callsites are explored, each once
+    IdSet queriedCalls;                 // Callsite IDs printed
+    IdSet demandedCalls;                // Callsite IDs whose callees are bound
+    IdSet demandedCallers;              // Function IDs whose callsites are demanded
+    DenseSet<Value *> exploredValues;
+    vector<Value *> demandedValues;     // Worklist of values to explore
+    DenseMap<FunctionType *, vector<CallBase *>> indirectCalls; // Function type -> indirect callsites
 
-    FuncPtrPass() : ModulePass(ID) {}
+    unique_ptr<legacy::FunctionPassManager> promotion; // SSA passes of a lazily loaded module
 
-    bool analyseFunction(Function *func, vector<Function *> &reachedFunc) {
-        bool changed = false;
-        bool tmp;
+    CallGraphWriter callGraphExport; // Filled when `ExportCallGraph` is given, names refer to the module
 
-        assert(func != nullptr);
-#ifdef ASSIGNMENT_DEBUG_DUMP
-        fprintf(stderr, "[*] Analysing function %s at %p.\n",
-                func->getName().data(), func);
-#endif
+    FuncPtrPass() : ModulePass(ID), CallGraphResolver(UnifyPointers) {}
 
-        for (auto &BB: *func) {
-            for (auto &inst: BB) {
-                if (auto *callBase = dyn_cast<CallBase>(&inst)) { // Handle Callsite
-                    vector<Function *> calledFuncs;
-                    if (!callBase->isIndirectCall()) { // Handle direct call
-                        auto *calledFunc = callBase->getCalledFunction();
-                        auto calledFuncName = calledFunc->getName();
-                        if (!calledFuncName.startswith("llvm.dbg")) { // Disregard llvm internal debug functions
-                            tmp = add_if_not_exist(callGraphNode[func], callBase);
-                            tmp |= add_if_not_exist(callGraphEdge[callBase], calledFunc);
-                            tmp |= add_if_not_exist(reachedFunc, calledFunc);
-                            changed |= tmp;
-                            calledFuncs.push_back(calledFunc);
-#ifdef ASSIGNMENT_DEBUG_DUMP
-                            fprintf(stderr, "\t- Handling direct function call %s (%p) at line %d: %d.\n",
-                                    calledFuncName.data(), calledFunc, inst.getDebugLoc().getLine(), tmp);
-#endif
-                        }
+    // The ID getters grow the tables indexed by the ID, don't hold references into them across calls
+    unsigned getPtrId(Value *value) {
+        return ptrIds.getId(value);
+    }
 
-                    } else { // Handle indirect call
-                        Value *calledFuncValue = callBase->getCalledOperand(); // This should be a function pointer definition statement
+    unsigned getFuncId(Function *func) {
+        unsigned funcId = funcIds.getId(func);
+        if (funcId >= callGraphNode.size()) callGraphNode.resize(funcId + 1);
+        return funcId;
+    }
 
-                        tmp = add_if_not_exist(funcPtr, calledFuncValue);
-                        tmp |= add_if_not_exist(funcCall, callBase);
-                        changed |= tmp;
+    unsigned getCallId(CallBase *callBase) {
+        unsigned callId = callIds.getId(callBase);
+        if (callId >= callGraphEdge.size()) {
+            resizeCallSites(callId + 1);
+            callSites.resize(callId + 1);
+        }
+        return callId;
+    }
 
-                        copy(funcPtrValue[calledFuncValue].begin(), funcPtrValue[calledFuncValue].end(),
-                             back_inserter(calledFuncs));
-                        for (auto bindedFuncPtr: funcPtrBind[calledFuncValue]) {
-                            copy(funcPtrValue[bindedFuncPtr].begin(), funcPtrValue[bindedFuncPtr].end(),
-                                 back_inserter(calledFuncs));
-                        }
+    // The summary of a function, extracted on first use when not all of them are. A query of a lazily loaded
+    // module promotes the function to SSA only then.
+    const FuncPtrSummary &getSummary(unsigned funcId) {
+        if (!summarized[funcId]) {
+            summarized[funcId] = true;
+            Function *func = funcIds.getValue(funcId);
+            if (promotion && !QueryLines.empty()) promotion->run(*func);
+            summaries[funcId].extract(func);
+        }
+        return summaries[funcId];
+    }
 
+    void registerCallSites(const FuncPtrSummary &summary) {
+        for (auto &callSite: summary.callSites) {
+            callSites[getCallId(callSite.callBase)] = &callSite;
+        }
+    }
 
+    // Bind the function pointer arguments and return value of a callsite to a possible callee
+    void bindCallee(unsigned callId, unsigned calledFuncId) {
+        const FuncPtrSummary::CallSite &callSite = *callSites[callId];
+        CallBase *callBase = callSite.callBase;
+        Function *calledFunc = funcIds.getValue(calledFuncId);
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                        fprintf(stderr, "\t- Handling indirect function (pointer) call %s (%p) at line %d: %d.\n",
-                                calledFuncValue->getName().data(), calledFuncValue,
-                                inst.getDebugLoc().getLine(), tmp);
+        fprintf(stderr, "\t\t- Possible callee for callsite at line %d: %s (%p).\n",
+                callBase->getDebugLoc().getLine(), calledFunc->getName().data(), calledFunc);
 #endif
-                    }
+        // Handle call function pointer argument to parameter binding
+        for (Use *callArgument: callSite.funcPtrArgs) {
+            auto callParameter = calledFunc->getArg(callArgument->getOperandNo());
+            unsigned paramId = getPtrId(callParameter);
+
+            if (!isa<Function>(callArgument->get())) { // Assign a function pointer argument to parameter
+                unsigned argumentId = getPtrId(*callArgument);
+                funcPtrGraph.addCopy(argumentId, paramId);
+                demand(*callArgument);
 
-                    for (auto calledFunc: calledFuncs) {
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                        fprintf(stderr, "\t\t- Possible callee for this callsite: %s (%p).\n",
-                                calledFunc->getName().data(), calledFunc);
+                fprintf(stderr,
+                        "\t\t\t- Handling %dth function pointer argument %s (%p) to parameter %s (%p) binding.\n",
+                        callArgument->getOperandNo(), (*callArgument)->getName().data(), callArgument,
+                        callParameter->getName().data(), callParameter);
 #endif
-                        // Handle call function pointer argument to parameter binding
-                        for (auto &callArgument: callBase->args()) {
-                            // Process function pointers only
-                            if (!callArgument->getType()->isPointerTy()) continue;
-                            if (!dyn_cast<PointerType>(
-                                    callArgument->getType())->getElementType()->isFunctionTy())
-                                continue;
-
-                            auto callParameter = calledFunc->getArg(callArgument.getOperandNo());
-
-                            tmp = add_if_not_exist(funcPtr, cast<Value>(callParameter));
-                            if (!isa<Function>(callArgument)) { // Assign a function pointer argument to parameter
-                                tmp |= add_if_not_exist(funcPtr, cast<Value>(callArgument));
-                                tmp |= add_if_not_exist(funcPtrBind[cast<Value>(callParameter)],
-                                                        cast<Value>(callArgument));
-
+            } else { // Assign a function entity argument to parameter
+                unsigned argumentFuncId = getFuncId(cast<Function>(callArgument->get()));
+                funcPtrGraph.addValue(paramId, argumentFuncId);
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                                fprintf(stderr,
-                                        "\t\t\t- Handling %dth function pointer argument %s (%p) to parameter %s (%p) binding: %d.\n",
-                                        callArgument.getOperandNo(), callArgument->getName().data(), &callArgument,
-                                        callParameter->getName().data(), callParameter, tmp);
+                fprintf(stderr,
+                        "\t\t\t- Handling %dth function entity argument %s (%p) to parameter %s (%p) assigning.\n",
+                        callArgument->getOperandNo(), (*callArgument)->getName().data(), callArgument,
+                        callParameter->getName().data(), callParameter);
 #endif
-                            } else { // Assign a function entity argument to parameter
-                                tmp |= add_if_not_exist(funcPtrValue[cast<Value>(callParameter)],
-                                                        cast<Function>(callArgument));
+            }
+        }
+
+        // Handle call function pointer return value binding, a declaration has no return value
+        ReturnInst *retInst = getSummary(calledFuncId).firstReturn;
+        if (!isFuncPtrType(calledFunc->getReturnType()) || !retInst) return;
+        Value *retValue = retInst->getReturnValue();
+        funcPtrGraph.addCopy(getPtrId(retValue), getPtrId(callBase));
+        demand(retValue);
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                                fprintf(stderr,
-                                        "\t\t\t- Handling %dth function entity argument %s (%p) to parameter %s (%p) assigning: %d.\n",
-                                        callArgument.getOperandNo(), callArgument->getName().data(), &callArgument,
-                                        callParameter->getName().data(), callParameter, tmp);
+        fprintf(stderr, "\t\t\t- Handling function pointer return value binding from caller site: "
+                        "%s (%p) -> %s (%p)\n", retValue->getName().data(), retValue,
+                callBase->getName().data(), callBase);
 #endif
-                            }
-                            changed |= tmp;
-                        }
-
-                        // Handle call function pointer return value binding
-                        do {
-                            auto functionRetValType = calledFunc->getReturnType();
-                            if (!functionRetValType->isPointerTy()) break;
-                            if (!dyn_cast<PointerType>(functionRetValType)->getElementType()->isFunctionTy())
-                                break;
-                            if (!funcRetValue.count(calledFunc)) {
-                                // calledFunc hasn't been visited, defering process
+    }
+
+    // Add the facts of a function that don't depend on function pointer values, and watch its indirect calls
+    void analyseFunction(unsigned funcId) {
+        bool tmp;
+
+        const FuncPtrSummary &summary = summaries[funcId];
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                                fprintf(stderr, "\t\t\t- Defered handling function pointer return value binding.\n");
+        Function *func = funcIds.getValue(funcId);
+        fprintf(stderr, "[*] Analysing function %s at %p.\n",
+                func->getName().data(), func);
 #endif
-                                changed = true;
-                            } else {
-                                // calledFunc has been visited, do binding
-                                tmp = add_if_not_exist(funcPtr, cast<Value>(funcRetValue[calledFunc]));
-                                tmp |= add_if_not_exist(funcPtrBind[cast<Value>(callBase)],
-                                                       funcRetValue[calledFunc]);
-                                changed |= tmp;
+
+        registerCallSites(summary);
+        for (auto &callSite: summary.callSites) { // Handle Callsite
+            CallBase *callBase = callSite.callBase;
+            unsigned callId = getCallId(callBase);
+            if (callSite.calledFunc) { // Handle direct call
+                unsigned calledFuncId = getFuncId(callSite.calledFunc);
+                tmp = callGraphNode[funcId].insert(callId);
+                tmp |= addDirectCall(callId, calledFuncId);
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                                fprintf(stderr, "\t\t\t- Handling function pointer return value binding from caller site: "
-                                                "%s (%p) -> %s (%p): %d\n", funcRetValue[calledFunc]->getName().data(), funcRetValue[calledFunc],
-                                        callBase->getName().data(), callBase, tmp);
+                fprintf(stderr, "\t- Handled direct function call %s (%p) at line %d: %d.\n",
+                        callSite.calledFunc->getName().data(), callSite.calledFunc,
+                        callBase->getDebugLoc().getLine(), tmp);
 #endif
-                            }
-                        } while (false);
-                    }
-
-                } else if (auto *phiNode = dyn_cast<PHINode>(&inst)) { // Handle PhiNode
-                    // Process function pointers only
-                    if (!phiNode->getType()->isPointerTy()) continue;
-                    if (!dyn_cast<PointerType>(phiNode->getType())->getElementType()->isFunctionTy()) continue;
-
-                    for (auto &use: phiNode->operands()) {
-                        if (Function *calleeFunc = dyn_cast<Function>(&use)) {
-                            tmp = add_if_not_exist(funcPtrValue[cast<Value>(phiNode)], calleeFunc);
-                            changed |= tmp;
+
+            } else { // Handle indirect call, resolved once the called pointer has values
+                addIndirectCall(callId);
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                            fprintf(stderr, "\t- Possible callee for %s: %s, %d.\n",
-                                    phiNode->getName().data(), calleeFunc->getName().data(), tmp);
+                Value *calledFuncValue = callBase->getCalledOperand(); // This should be a function pointer definition statement
+                fprintf(stderr, "\t- Handling indirect function (pointer) call %s (%p) at line %d.\n",
+                        calledFuncValue->getName().data(), calledFuncValue,
+                        callBase->getDebugLoc().getLine());
 #endif
-                        } else if (ConstantPointerNull *nullFuncPtr = dyn_cast<ConstantPointerNull>(&use)) {
+            }
+        }
+
+        for (PHINode *phiNode: summary.funcPtrPhis) {
+            bindPhi(phiNode);
+        }
+    }
+
+    // Handle PhiNode
+    void bindPhi(PHINode *phiNode) {
+        unsigned phiId = getPtrId(phiNode);
+
+        for (auto &use: phiNode->operands()) {
+            if (Function *calleeFunc = dyn_cast<Function>(&use)) {
+                unsigned calleeFuncId = getFuncId(calleeFunc);
+                funcPtrGraph.addValue(phiId, calleeFuncId);
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                            fprintf(stderr, "\t- Possible callee for %s: NULL, discarded.\n",
-                                    phiNode->getName().data());
+                fprintf(stderr, "\t- Possible callee for %s: %s.\n",
+                        phiNode->getName().data(), calleeFunc->getName().data());
 #endif
-                        } else if (use->getType()->isPointerTy() &&
-                                   dyn_cast<PointerType>(use->getType())->getElementType()->isFunctionTy()) {
-                            tmp = add_if_not_exist(funcPtr, cast<Value>(phiNode));
-                            tmp |= add_if_not_exist(funcPtr, cast<Value>(&use));
-                            tmp |= add_if_not_exist(funcPtrBind[cast<Value>(phiNode)], cast<Value>(&use));
-                            changed |= tmp;
+            } else if (isa<ConstantPointerNull>(&use)) {
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                            fprintf(stderr, "\t- Binding function pointer %s to %s: %d.\n",
-                                    use->getName().data(), phiNode->getName().data(), tmp);
+                fprintf(stderr, "\t- Possible callee for %s: NULL, discarded.\n",
+                        phiNode->getName().data());
 #endif
-                        } else {
-                            assert(false);
-                        }
-                    }
-                } else if (auto * retInst = dyn_cast<ReturnInst>(&inst)) {
-                    tmp = funcRetValue.count(func);
-                    if (!tmp) funcRetValue[func] = retInst->getReturnValue();
+            } else if (isFuncPtrType(use->getType())) {
+                unsigned useId = getPtrId(use);
+                funcPtrGraph.addCopy(useId, phiId);
+                demand(use);
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                    fprintf(stderr, "\t- Handling function pointer return value binding from callee site: "
-                                    "%s(%p): %d.\n", retInst->getReturnValue()->getName().data(), retInst->getReturnValue(), !tmp);
+                fprintf(stderr, "\t- Binding function pointer %s to %s.\n",
+                        use->getName().data(), phiNode->getName().data());
 #endif
-                }
+            } else {
+                assert(false);
             }
         }
-        return changed;
     }
 
-    void buildCallGraph(Module &m, Function *entrypoint) {
-        vector<Function *> reachedFunc;
-        bool callGraphChanged = true;
-        bool tmp;
+    unsigned getCalledNode(unsigned callId) {
+        return getPtrId(callSites[callId]->callBase->getCalledOperand());
+    }
 
-        callGraphNode[entrypoint].push_back(nullptr);
-        reachedFunc.push_back(entrypoint);
+    FunctionType *getCallSignature(unsigned callId) {
+        return callSites[callId]->callBase->getFunctionType();
+    }
 
-#ifdef ASSIGNMENT_DEBUG_DUMP
-        int loopCounter = 0;
-#endif
+    StringRef getFuncName(unsigned funcId) {
+        return funcIds.getValue(funcId)->getName();
+    }
 
-        while (callGraphChanged) {
-            callGraphChanged = false;
-#ifdef ASSIGNMENT_DEBUG_DUMP
-            fprintf(stderr, "[*] Building call graph: loop %d.\n", ++loopCounter);
-#endif
-            for (auto *reachedFuncPtr: reachedFunc) {
-                callGraphChanged |= analyseFunction(reachedFuncPtr, reachedFunc);
-            }
+    // Queue a value flowing into a demanded one, unless every function is analysed anyway
+    void demand(Value *value) {
+        if (QueryLines.empty() || !exploredValues.insert(value).second) return;
+        demandedValues.push_back(value);
+    }
 
-            bool funcPtrChanged = true;
-            while (funcPtrChanged) {
-                funcPtrChanged = false;
-#ifdef ASSIGNMENT_DEBUG_DUMP
-                fprintf(stderr, "[*] Building call graph: propagating bindings: loop %d.\n", loopCounter);
-#endif
-                for (auto funcPtr1: funcPtr) {
-                    for (auto funcPtr2: funcPtr) {
-                        if (funcPtr1 == funcPtr2) continue;
-                        auto &funcPtr1Bind = funcPtrBind[funcPtr1], &funcPtr2Bind = funcPtrBind[funcPtr2];
-                        if (count(funcPtr1Bind.begin(), funcPtr1Bind.end(), funcPtr2)) {
-                            // Sort two funcPtrBind vector to compare them in order to decide whether to propagate bindings
-                            stable_sort(funcPtr1Bind.begin(), funcPtr1Bind.end());
-                            stable_sort(funcPtr2Bind.begin(), funcPtr2Bind.end());
-                            if (!includes(funcPtr1Bind.begin(), funcPtr1Bind.end(),
-                                          funcPtr2Bind.begin(), funcPtr2Bind.end())) {
-                                vector<Value *> tmpContainer;
-#ifdef ASSIGNMENT_DEBUG_DUMP
-                                fprintf(stderr, "\t- Transmitting function pointer closure "
-                                                "%s (%p) to %s (%p).\n",
-                                        funcPtr2->getName().data(), funcPtr2,
-                                        funcPtr1->getName().data(), funcPtr1);
-#endif
-                                // Union funcPtr2Bind to funcPtr1Bind if they are not equal
-                                set_union(funcPtr1Bind.begin(), funcPtr1Bind.end(),
-                                          funcPtr2Bind.begin(), funcPtr2Bind.end(),
-                                          back_inserter(tmpContainer));
-                                // Swap the content of tmpContainer (unioned result) and funcPtr1Bind which reduced
-                                // the copy overhead and release the useless data chunk after leaving the scope
-                                funcPtr1Bind.swap(tmpContainer);
-                                funcPtrChanged = true;
-                            }
-                        }
-                    }
+    // Add the facts a value depends on: the operands of a phi node, the arguments passed to a parameter or the
+    // return values of the callees of a callsite. A function entity as a pointer value has no values itself.
+    void exploreValue(Value *value) {
+        if (auto *phiNode = dyn_cast<PHINode>(value)) {
+            bindPhi(phiNode);
+        } else if (auto *param = dyn_cast<Argument>(value)) {
+            demandCallers(param->getParent());
+        } else if (auto *callBase = dyn_cast<CallBase>(value)) {
+            demandCall(callBase);
+        }
+    }
+
+    void exploreDemanded() {
+        while (!demandedValues.empty()) {
+            Value *value = demandedValues.back();
+            demandedValues.pop_back();
+            exploreValue(value);
+        }
+    }
+
+    // Demand every callsite which may bind the parameters of `func`
+    void demandCallers(Function *func) {
+        if (!demandedCallers.insert(getFuncId(func))) return;
+        for (User *user: func->users()) {
+            auto *callBase = dyn_cast<CallBase>(user);
+            if (callBase && callBase->getCalledOperand() == func) demandCall(callBase);
+        }
+        if (!func->hasAddressTaken()) return;
+        for (CallBase *callBase: indirectCalls.lookup(func->getFunctionType())) {
+            demandCall(callBase);
+        }
+    }
+
+    // Bind a callsite to its callees, for an indirect one as they are resolved
+    void demandCall(CallBase *callBase) {
+        unsigned callId = getCallId(callBase);
+        if (!demandedCalls.insert(callId)) return;
+        registerCallSites(getSummary(getFuncId(callBase->getFunction())));
+        const FuncPtrSummary::CallSite *callSite = callSites[callId];
+        if (!callSite) return; // Call of a llvm.dbg intrinsic
+        if (callSite->calledFunc) {
+            addDirectCall(callId, getFuncId(callSite->calledFunc));
+        } else {
+            addIndirectCall(callId);
+            demand(callBase->getCalledOperand());
+        }
+    }
+
+    // Demand the callsites on the queried lines, indexing indirect callsites by signature on the way
+    void queryCallSites() {
+        DenseSet<unsigned> lines(QueryLines.begin(), QueryLines.end());
+        for (unsigned funcId = 0; funcId < funcIds.size(); funcId++) {
+            for (auto &BB: *funcIds.getValue(funcId)) {
+                for (auto &inst: BB) {
+                    auto *callBase = dyn_cast<CallBase>(&inst);
+                    if (!callBase) continue;
+                    if (callBase->isIndirectCall()) indirectCalls[callBase->getFunctionType()].push_back(callBase);
+                    if (lines.count(callBase->getDebugLoc().getLine())) queriedCalls.insert(getCallId(callBase));
                 }
-#ifdef ASSIGNMENT_DEBUG_DUMP
-                fprintf(stderr, "[*] Building call graph: modifying call graph: loop %d.\n", loopCounter);
-#endif
-                for (auto callBase: funcCall) {
-                    auto calledFuncPtr = callBase->getCalledOperand();
+            }
+        }
+        for (unsigned callId: queriedCalls) {
+            demandCall(callIds.getValue(callId));
+        }
+    }
 
-                    for (auto maybeCalleeFunc: funcPtrValue[calledFuncPtr]) {
-                        tmp = add_if_not_exist(callGraphNode[maybeCalleeFunc], static_cast<CallBase *>(nullptr));
-                        tmp |= add_if_not_exist(callGraphEdge[callBase], maybeCalleeFunc);
-                        tmp |= add_if_not_exist(reachedFunc, maybeCalleeFunc);
-#ifdef ASSIGNMENT_DEBUG_DUMP
-                        fprintf(stderr, "\t- Adding new function %s in %s through PVVal, %d.\n",
-                                maybeCalleeFunc->getName().data(), calledFuncPtr->getName().data(), tmp);
-#endif
-                    }
+    // Read the bodies of numbered functions of a lazily loaded module one at a time. Every body is needed, for the
+    // callsites of the queried lines and the uses taking the address of functions, but a query only promotes the
+    // functions it reaches to SSA (see getSummary), the others are promoted right away. Materializing isn't thread
+    // safe, so it precedes the parallel summaries.
+    void materializeFunctions(Module &m) {
+        if (!m.getMaterializer()) return;
+        AnalysisStatistics::Phase phase(Statistics, "mem2reg"); // Reading the bodies included
+        promotion.reset(new legacy::FunctionPassManager(&m));
+        promotion->add(new EnableFunctionOptPass());
+        promotion->add(createPromoteMemoryToRegisterPass());
+        promotion->doInitialization();
+        for (unsigned funcId = 0; funcId < funcIds.size(); funcId++) {
+            Function *func = funcIds.getValue(funcId);
+            if (!func->isMaterializable()) continue;
+            if (Error error = func->materialize()) {
+                report_fatal_error(std::move(error));
+            }
+            if (QueryLines.empty()) promotion->run(*func);
+        }
+    }
 
-                    for (auto bindingFuncPtr: funcPtrBind[calledFuncPtr]) {
-#ifdef ASSIGNMENT_DEBUG_DUMP
-                        fprintf(stderr, "\t- Adding functions via %s through PVBind.\n",
-                                calledFuncPtr->getName().data());
-#endif
-                        for (auto maybeCalleeFunc: funcPtrValue[bindingFuncPtr]) {
-                            tmp = add_if_not_exist(callGraphNode[maybeCalleeFunc], static_cast<CallBase *>(nullptr));
-                            tmp |= add_if_not_exist(callGraphEdge[callBase], maybeCalleeFunc);
-                            tmp |= add_if_not_exist(reachedFunc, maybeCalleeFunc);
+    // Bucket the functions that may be called indirectly by signature, once all bodies holding their uses are read
+    void indexAddressTakenFuncs() {
+        for (unsigned funcId = 0; funcId < funcIds.size(); funcId++) {
+            Function *func = funcIds.getValue(funcId);
+            if (func->hasAddressTaken()) addAddressTaken(func->getFunctionType(), funcId);
+        }
+    }
+
+    // Summarize every numbered function on a thread pool, each task writing only its own summaries
+    void summarizeFunctions() {
+        const unsigned chunkSize = 64;
+        summaries.resize(funcIds.size());
+        ThreadPool pool(hardware_concurrency(ThreadCount));
+        for (unsigned begin = 0; begin < summaries.size(); begin += chunkSize) {
+            unsigned end = min(begin + chunkSize, static_cast<unsigned>(summaries.size()));
+            pool.async([this, begin, end] {
+                for (unsigned funcId = begin; funcId < end; funcId++) {
+                    summaries[funcId].extract(funcIds.getValue(funcId));
+                }
+            });
+        }
+        pool.wait();
+        summarized.assign(summaries.size(), true);
+    }
+
+    // Each function is analysed once, then resolveCallGraph binds the indirect callsites. Queries only analyse
+    // what flows into the queried callsites, but reach the same fixpoint there.
+    void buildCallGraph(Module &m) {
+        for (auto &func: m) {
+            if (func.getName().startswith("llvm.dbg")) continue;
 #ifdef ASSIGNMENT_DEBUG_DUMP
-                            fprintf(stderr, "\t\t- Adding new function %s in %s through PVBind, %d.\n",
-                                    maybeCalleeFunc->getName().data(), bindingFuncPtr->getName().data(), tmp);
+            fprintf(stderr, "[!] Analyse Entrypoint: %s.\n", func.getName().data());
 #endif
-                        }
-                    }
-                }
+            getFuncId(&func);
+        }
+        // Functions only reach functions of the module, so all of them are numbered already
+        materializeFunctions(m);
+        indexAddressTakenFuncs();
+        if (QueryLines.empty()) {
+            AnalysisStatistics::Phase phase(Statistics, "extract");
+            summarizeFunctions();
+            for (unsigned funcId = 0; funcId < summaries.size(); funcId++) {
+                analyseFunction(funcId);
             }
+        } else {
+            summaries.resize(funcIds.size());
+            summarized.assign(funcIds.size(), false);
+            queryCallSites();
         }
 
+        AnalysisStatistics::Phase phase(Statistics, "solve"); // Queries extract summaries on the way
+        resolveCallGraph();
+        if (promotion) promotion->doFinalization();
     }
 
     void printResult() {
-        map<unsigned int, vector<string>> sortContainer;
-
-        for_each(callGraphEdge.begin(), callGraphEdge.end(), [&](auto &pair) {
-            CallBase *callBase = pair.first;
-            vector<Function *> callees = pair.second;
-            unsigned int sourceLine = callBase->getDebugLoc().getLine();
-            for_each(callees.begin(), callees.end(), [&](Function *callee) {
-                sortContainer[sourceLine].push_back(callee->getName().data());
-            });
+        AnalysisStatistics::Phase phase(Statistics, "print");
+        printCallGraph([&](unsigned callId, unsigned &, unsigned &line) {
+            if (!QueryLines.empty() && !queriedCalls.contains(callId)) return false;
+            line = callIds.getValue(callId)->getDebugLoc().getLine();
+            return true;
         });
+    }
 
-        for_each(sortContainer.begin(), sortContainer.end(), [&](auto &lineCalleeNamePairs) {
-            int lineNumber = lineCalleeNamePairs.first;
-            vector<string> &lineCallees = lineCalleeNamePairs.second;
-            stable_sort(lineCallees.begin(), lineCallees.end());
-            printf("%u :", lineNumber);
-            bool flag = true;
-            for (auto &maybeCalledFuncName: lineCallees) {
-                printf(", %s" + flag, maybeCalledFuncName.data());
-                flag = false;
-            }
-            printf("\n");
-        });
+    // Export the callsites printed, with function IDs as function indices
+    void exportCallGraph() {
+        for (unsigned funcId = 0; funcId < funcIds.size(); funcId++) {
+            callGraphExport.addFunction(funcIds.getValue(funcId)->getName());
+        }
+        for (unsigned callId = 0; callId < callIds.size(); callId++) {
+            if (!QueryLines.empty() && !queriedCalls.contains(callId)) continue;
+            CallBase *callBase = callIds.getValue(callId);
+            DILocation *location = callBase->getDebugLoc().get();
+            unsigned file = callGraphExport.getFile(location ? location->getFilename() : "");
+            callGraphExport.addCallSite(getFuncId(callBase->getFunction()), file, callBase->getDebugLoc().getLine(),
+                                        callGraphEdge[callId]);
+        }
+    }
+
+    void addStatistics() {
+        Statistics.setCounter("functions", funcIds.size());
+        CallGraphResolver::addStatistics(Statistics);
     }
 
     void main(Module &m) {
-        for (auto &funcIter: m) {
-            if (!funcIter.getName().startswith("llvm.dbg")) {
-#ifdef ASSIGNMENT_DEBUG_DUMP
-                fprintf(stderr, "\n\n[!] Analyse Entrypoint: %s.\n", funcIter.getName().data());
-#endif
-                buildCallGraph(m, &funcIter);
-            }
-        }
+        buildCallGraph(m);
         printResult();
+        if (!ExportCallGraph.empty()) exportCallGraph();
+        if (!StatsFile.empty()) addStatistics();
     }
 
     bool runOnModule(Module &M) override {
@@ -371,11 +494,101 @@ struct FuncPtrPass : public ModulePass {
 char FuncPtrPass::ID = 0;
 static RegisterPass<FuncPtrPass> X("funcptrpass", "Print function call instruction");
 
+static cl::list<std::string>
+        InputFilenames(cl::Positional,
+                       cl::desc("<filename>.bc..."),
+                       cl::OneOrMore);
+
 static cl::opt<std::string>
-        InputFilename(cl::Positional,
-                      cl::desc("<filename>.bc"),
-                      cl::init(""));
+        SummaryCache("summary-cache",
+                     cl::desc("Directory caching the summary of every input module by the hash of its bitcode"),
+                     cl::init(""));
+
+// Summary of a bitcode file, read from `SummaryCache` when an identical file was summarized before
+static std::unique_ptr<ModuleSummary> loadSummary(const std::string &filename, const char *argv0) {
+    Optional<AnalysisStatistics::Phase> phase;
+    phase.emplace(Statistics, "load");
+    ErrorOr<std::unique_ptr<MemoryBuffer>> buffer = MemoryBuffer::getFile(filename);
+    if (!buffer) {
+        errs() << argv0 << ": " << filename << ": " << buffer.getError().message() << "\n";
+        return nullptr;
+    }
+    std::unique_ptr<ModuleSummary> summary(new ModuleSummary());
+    std::string cachePath;
+    if (!SummaryCache.empty()) {
+        StringRef bitcode = (*buffer)->getBuffer();
+        cachePath = SummaryCache + "/" + toHex(SHA1::hash(arrayRefFromStringRef(bitcode)), true) + ".summary";
+        ErrorOr<std::unique_ptr<MemoryBuffer>> cached = MemoryBuffer::getFile(cachePath);
+        if (cached && summary->read((*cached)->getBuffer())) return summary;
+        summary.reset(new ModuleSummary()); // Outdated or corrupt
+    }
 
+    LLVMContext context; // Types of the module are freed with its own context
+    SMDiagnostic err;
+    std::unique_ptr<Module> m = parseIR((*buffer)->getMemBufferRef(), err, context);
+    if (!m) {
+        err.print(argv0, errs());
+        return nullptr;
+    }
+    phase.emplace(Statistics, "mem2reg");
+    llvm::legacy::PassManager passes;
+    passes.add(new EnableFunctionOptPass());
+    passes.add(llvm::createPromoteMemoryToRegisterPass());
+    passes.run(*m);
+    phase.emplace(Statistics, "extract"); // Writing the summary to the cache included
+    summary->extract(*m);
+
+    if (!cachePath.empty()) {
+        // Written aside and renamed, so concurrent runs never read a partial summary
+        std::string tmpPath = cachePath + "." + std::to_string(sys::Process::getProcessId());
+        std::error_code error = sys::fs::create_directories(SummaryCache);
+        raw_fd_ostream os(tmpPath, error);
+        if (!error) {
+            summary->write(os);
+            os.close();
+            if (os.has_error() || sys::fs::rename(tmpPath, cachePath)) {
+                os.clear_error();
+                sys::fs::remove(tmpPath);
+            }
+        }
+    }
+    return summary;
+}
+
+// Write the call graph to `ExportCallGraph`, return whether that failed
+static bool writeCallGraph(const CallGraphWriter &writer, const char *argv0) {
+    std::error_code error;
+    raw_fd_ostream os(ExportCallGraph, error);
+    if (!error) {
+        writer.write(os);
+        os.close();
+        if (!os.has_error()) return false;
+        error = os.error();
+        os.clear_error();
+    }
+    errs() << argv0 << ": " << ExportCallGraph << ": " << error.message() << "\n";
+    return true;
+}
+
+// Write the statistics collected when `StatsFile` is given, return whether that failed
+static bool writeStatistics(const char *argv0) {
+    if (StatsFile.empty()) return false;
+    if (StatsFile == "-") {
+        Statistics.write(errs());
+        return false;
+    }
+    std::error_code error;
+    raw_fd_ostream os(StatsFile, error);
+    if (!error) {
+        Statistics.write(os);
+        os.close();
+        if (!os.has_error()) return false;
+        error = os.error();
+        os.clear_error();
+    }
+    errs() << argv0 << ": " << StatsFile << ": " << error.message() << "\n";
+    return true;
+}
 
 int main(int argc, char **argv) {
     LLVMContext &Context = getGlobalContext();
@@ -384,23 +597,65 @@ int main(int argc, char **argv) {
     cl::ParseCommandLineOptions(argc, argv,
                                 "FuncPtrPass \n Analyse function invocations.\n");
 
+    // Several modules are linked as summaries, which can be cached. Each input is read whole and summarized on
+    // the main thread, so the options of the IR analysis don't apply.
+    if (InputFilenames.size() > 1 || !SummaryCache.empty()) {
+        if (!QueryLines.empty() || LazyLoad || ThreadCount.getNumOccurrences()) {
+            errs() << argv[0] << ": -lines, -lazy and -threads need a single input and no -summary-cache\n";
+            return 1;
+        }
+        SummaryLinker linker(UnifyPointers);
+        for (auto &filename: InputFilenames) {
+            std::unique_ptr<ModuleSummary> summary = loadSummary(filename, argv[0]);
+            if (!summary) return 1;
+            linker.add(std::move(summary));
+        }
+        {
+            AnalysisStatistics::Phase phase(Statistics, "solve");
+            linker.link();
+        }
+        {
+            AnalysisStatistics::Phase phase(Statistics, "print");
+            linker.print(InputFilenames.size() > 1);
+        }
+        bool failed = false;
+        if (!ExportCallGraph.empty()) {
+            CallGraphWriter writer;
+            linker.exportCallGraph(writer);
+            failed = writeCallGraph(writer, argv[0]);
+        }
+        if (!StatsFile.empty()) linker.addStatistics(Statistics);
+        return writeStatistics(argv[0]) || failed;
+    }
 
-    // Load the input module
-    std::unique_ptr<Module> M = parseIRFile(InputFilename, Err, Context);
+    // Load the input module, function bodies are left in the file by a lazy load
+    std::unique_ptr<Module> M;
+    {
+        AnalysisStatistics::Phase phase(Statistics, "load");
+        M = LazyLoad ? getLazyIRFileModule(InputFilenames[0], Err, Context)
+                     : parseIRFile(InputFilenames[0], Err, Context);
+    }
     if (!M) {
         Err.print(argv[0], errs());
         return 1;
     }
 
-    llvm::legacy::PassManager Passes;
-
-    ///Remove functions' optnone attribute in LLVM5.0
-    Passes.add(new EnableFunctionOptPass());
-    ///Transform it to SSA
-    Passes.add(llvm::createPromoteMemoryToRegisterPass());
+    if (!LazyLoad) { // FuncPtrPass does both per function when loading lazily
+        AnalysisStatistics::Phase phase(Statistics, "mem2reg");
+        llvm::legacy::PassManager Passes;
+        ///Remove functions' optnone attribute in LLVM5.0
+        Passes.add(new EnableFunctionOptPass());
+        ///Transform it to SSA
+        Passes.add(llvm::createPromoteMemoryToRegisterPass());
+        Passes.run(*M.get());
+    }
 
     /// Your pass to print Function and Call Instructions
-    Passes.add(new FuncPtrPass());
+    llvm::legacy::PassManager Passes;
+    auto *Pass = new FuncPtrPass(); // Owned by `Passes`
+    Passes.add(Pass);
     Passes.run(*M.get());
+    bool failed = !ExportCallGraph.empty() && writeCallGraph(Pass->callGraphExport, argv[0]);
+    return writeStatistics(argv[0]) || failed;
 }
 
@@ -0,0 +1,318 @@
+#ifndef ASSIGN2_MODULE_SUMMARY_H
+#define ASSIGN2_MODULE_SUMMARY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/EndianStream.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "util.hpp"
+#include "FuncPtrSummary.hpp"
+
+// Function pointer facts of a whole module, with IR pointers replaced by module local numbers and functions by
+// names and linkage, so the summary can be cached on disk and linked with the summaries of other modules. Numbers
+// refer to pointer nodes, or to `functions` for the function fields; -1 stands for none.
+struct ModuleSummary {
+    static constexpr uint32_t MAGIC = 0x53504641; // "AFPS"
+    static constexpr uint32_t VERSION = 3;
+
+    struct Function {
+        std::string name;
+        uint32_t type;                  // Index into `types`
+        bool defined;
+        bool local;                     // Internal or private, only its own module refers to it by name
+        bool addressTaken;
+        bool returnsFuncPtr;
+        int32_t retNode;                // The first returned value, -1 if it can't hold values
+        std::vector<int32_t> paramNodes; // -1 for parameters not of function pointer type
+    };
+
+    struct Argument {
+        uint32_t operandNo;
+        int32_t node;                   // A function pointer argument,
+        int32_t func;                   // or a function entity argument
+    };
+
+    struct CallSite {
+        uint32_t caller;                // Function containing the callsite
+        uint32_t file;                  // Index into `files`
+        uint32_t line;
+        uint32_t type;                  // Index into `types`
+        int32_t callee;                 // -1 for indirect calls
+        int32_t calledNode;             // Called pointer of indirect calls
+        int32_t resultNode;             // -1 unless the call returns a function pointer
+        std::vector<Argument> args;
+    };
+
+    struct Phi {
+        uint32_t node;
+        std::vector<int32_t> copies;
+        std::vector<int32_t> funcs;
+    };
+
+    std::vector<std::string> files;
+    std::vector<std::string> types;
+    std::vector<Function> functions;
+    std::vector<CallSite> callSites;
+    std::vector<Phi> phis;
+    uint32_t nodeCount;
+
+    ModuleSummary() : nodeCount(0) {}
+
+    // Summarize a module already promoted to SSA
+    void extract(llvm::Module &m) {
+        ValueNumbering<llvm::Value *> nodes;
+        llvm::DenseMap<llvm::Function *, int32_t> funcIndices;
+        llvm::StringMap<uint32_t> fileIndices, typeIndices;
+
+        auto getIndex = [](llvm::StringMap<uint32_t> &indices, std::vector<std::string> &strings,
+                           llvm::StringRef text) {
+            auto inserted = indices.insert(std::make_pair(text, static_cast<uint32_t>(strings.size())));
+            if (inserted.second) strings.push_back(text.str());
+            return inserted.first->second;
+        };
+        auto getTypeIndex = [&](llvm::Type *type) {
+            std::string name;
+            llvm::raw_string_ostream os(name);
+            type->print(os);
+            return getIndex(typeIndices, types, os.str());
+        };
+        auto getNode = [&](llvm::Value *value) {
+            return static_cast<int32_t>(nodes.getId(value));
+        };
+
+        for (auto &func: m) {
+            if (func.getName().startswith("llvm.dbg")) continue;
+            funcIndices[&func] = functions.size();
+            functions.push_back(Function{func.getName().str(), getTypeIndex(func.getFunctionType()),
+                                         !func.isDeclaration(), func.hasLocalLinkage(), func.hasAddressTaken(),
+                                         isFuncPtrType(func.getReturnType()), -1, {}});
+        }
+
+        for (auto &func: m) {
+            if (func.getName().startswith("llvm.dbg") || func.isDeclaration()) continue;
+            Function &summary = functions[funcIndices[&func]];
+            FuncPtrSummary funcSummary;
+            funcSummary.extract(&func);
+
+            for (auto &param: func.args()) {
+                summary.paramNodes.push_back(isFuncPtrType(param.getType()) ? getNode(&param) : -1);
+            }
+            if (funcSummary.firstReturn && summary.returnsFuncPtr) {
+                // A returned function entity is a pointer node without values
+                llvm::Value *retValue = funcSummary.firstReturn->getReturnValue();
+                if (!llvm::isa<llvm::Function>(retValue)) summary.retNode = getNode(retValue);
+            }
+
+            for (auto &callSite: funcSummary.callSites) {
+                llvm::CallBase *callBase = callSite.callBase;
+                llvm::DILocation *location = callBase->getDebugLoc().get();
+                CallSite summarySite{static_cast<uint32_t>(funcIndices[&func]),
+                                     getIndex(fileIndices, files, location ? location->getFilename() : ""),
+                                     callBase->getDebugLoc().getLine(),
+                                     getTypeIndex(callBase->getFunctionType()),
+                                     callSite.calledFunc ? funcIndices[callSite.calledFunc] : -1,
+                                     callSite.calledFunc ? -1 : getNode(callBase->getCalledOperand()),
+                                     isFuncPtrType(callBase->getType()) ? getNode(callBase) : -1, {}};
+                for (llvm::Use *callArgument: callSite.funcPtrArgs) {
+                    if (auto *argumentFunc = llvm::dyn_cast<llvm::Function>(callArgument->get())) {
+                        summarySite.args.push_back(Argument{callArgument->getOperandNo(), -1,
+                                                            funcIndices[argumentFunc]});
+                    } else {
+                        summarySite.args.push_back(Argument{callArgument->getOperandNo(), getNode(*callArgument), -1});
+                    }
+                }
+                callSites.push_back(std::move(summarySite));
+            }
+
+            for (llvm::PHINode *phiNode: funcSummary.funcPtrPhis) {
+                Phi phi{static_cast<uint32_t>(getNode(phiNode)), {}, {}};
+                for (auto &use: phiNode->operands()) {
+                    if (auto *calleeFunc = llvm::dyn_cast<llvm::Function>(&use)) {
+                        phi.funcs.push_back(funcIndices[calleeFunc]);
+                    } else if (llvm::isa<llvm::ConstantPointerNull>(&use)) {
+                        continue;
+                    } else if (isFuncPtrType(use->getType())) {
+                        phi.copies.push_back(getNode(use));
+                    } else {
+                        assert(false);
+                    }
+                }
+                phis.push_back(std::move(phi));
+            }
+        }
+        nodeCount = nodes.size();
+    }
+
+    void write(llvm::raw_ostream &os) const {
+        llvm::support::endian::Writer writer(os, llvm::support::little);
+        auto writeString = [&](const std::string &text) {
+            writer.write<uint32_t>(text.size());
+            os << text;
+        };
+        auto writeInts = [&](const std::vector<int32_t> &ints) {
+            writer.write<uint32_t>(ints.size());
+            for (int32_t value: ints) writer.write<int32_t>(value);
+        };
+
+        writer.write<uint32_t>(MAGIC);
+        writer.write<uint32_t>(VERSION);
+        writer.write<uint32_t>(nodeCount);
+        writer.write<uint32_t>(files.size());
+        for (auto &file: files) writeString(file);
+        writer.write<uint32_t>(types.size());
+        for (auto &type: types) writeString(type);
+        writer.write<uint32_t>(functions.size());
+        for (auto &func: functions) {
+            writeString(func.name);
+            writer.write<uint32_t>(func.type);
+            writer.write<uint8_t>(func.defined | func.addressTaken << 1 | func.returnsFuncPtr << 2 | func.local << 3);
+            writer.write<int32_t>(func.retNode);
+            writeInts(func.paramNodes);
+        }
+        writer.write<uint32_t>(callSites.size());
+        for (auto &callSite: callSites) {
+            writer.write<uint32_t>(callSite.caller);
+            writer.write<uint32_t>(callSite.file);
+            writer.write<uint32_t>(callSite.line);
+            writer.write<uint32_t>(callSite.type);
+            writer.write<int32_t>(callSite.callee);
+            writer.write<int32_t>(callSite.calledNode);
+            writer.write<int32_t>(callSite.resultNode);
+            writer.write<uint32_t>(callSite.args.size());
+            for (auto &argument: callSite.args) {
+                writer.write<uint32_t>(argument.operandNo);
+                writer.write<int32_t>(argument.node);
+                writer.write<int32_t>(argument.func);
+            }
+        }
+        writer.write<uint32_t>(phis.size());
+        for (auto &phi: phis) {
+            writer.write<uint32_t>(phi.node);
+            writeInts(phi.copies);
+            writeInts(phi.funcs);
+        }
+    }
+
+    // Return false on a truncated, foreign or outdated summary
+    bool read(llvm::StringRef data) {
+        const char *cursor = data.begin(), *end = data.end();
+        bool valid = true;
+        auto readU32 = [&]() -> uint32_t {
+            if (end - cursor < 4) {
+                valid = false;
+                return 0;
+            }
+            uint32_t value = llvm::support::endian::read32le(cursor);
+            cursor += 4;
+            return value;
+        };
+        auto readI32 = [&]() {
+            return static_cast<int32_t>(readU32());
+        };
+        auto readString = [&]() {
+            uint32_t size = readU32();
+            if (!valid || static_cast<uint32_t>(end - cursor) < size) {
+                valid = false;
+                return std::string();
+            }
+            std::string text(cursor, size);
+            cursor += size;
+            return text;
+        };
+        // Sizes are bounded by the remaining data, so corrupt counts can't allocate much
+        auto readSize = [&](size_t minElementSize) -> uint32_t {
+            uint32_t size = readU32();
+            if (!valid || static_cast<size_t>(end - cursor) / minElementSize < size) {
+                valid = false;
+                return 0;
+            }
+            return size;
+        };
+        auto readInts = [&](std::vector<int32_t> &ints) {
+            ints.resize(readSize(4));
+            for (auto &value: ints) value = readI32();
+        };
+
+        if (readU32() != MAGIC || readU32() != VERSION) return false;
+        nodeCount = readU32();
+        files.resize(readSize(4));
+        for (auto &file: files) file = readString();
+        types.resize(readSize(4));
+        for (auto &type: types) type = readString();
+        functions.resize(readSize(17));
+        for (auto &func: functions) {
+            func.name = readString();
+            func.type = readU32();
+            if (end - cursor < 1) return false;
+            uint8_t flags = *cursor++;
+            func.defined = flags & 1;
+            func.addressTaken = flags & 2;
+            func.returnsFuncPtr = flags & 4;
+            func.local = flags & 8;
+            func.retNode = readI32();
+            readInts(func.paramNodes);
+        }
+        callSites.resize(readSize(32));
+        for (auto &callSite: callSites) {
+            callSite.caller = readU32();
+            callSite.file = readU32();
+            callSite.line = readU32();
+            callSite.type = readU32();
+            callSite.callee = readI32();
+            callSite.calledNode = readI32();
+            callSite.resultNode = readI32();
+            callSite.args.resize(readSize(12));
+            for (auto &argument: callSite.args) {
+                argument.operandNo = readU32();
+                argument.node = readI32();
+                argument.func = readI32();
+            }
+        }
+        phis.resize(readSize(12));
+        for (auto &phi: phis) {
+            phi.node = readU32();
+            readInts(phi.copies);
+            readInts(phi.funcs);
+        }
+        return valid && cursor == end && isConsistent();
+    }
+
+private:
+    // Whether every number refers to an existing node, function, file or type
+    bool isConsistent() const {
+        auto isNode = [&](int32_t node, bool optional) {
+            return (optional && node == -1) || (node >= 0 && static_cast<uint32_t>(node) < nodeCount);
+        };
+        auto isFunc = [&](int32_t func, bool optional) {
+            return (optional && func == -1) || (func >= 0 && static_cast<size_t>(func) < functions.size());
+        };
+        for (auto &func: functions) {
+            if (func.type >= types.size() || !isNode(func.retNode, true)) return false;
+            for (int32_t node: func.paramNodes) if (!isNode(node, true)) return false;
+        }
+        for (auto &callSite: callSites) {
+            if (!isFunc(callSite.caller, false)) return false;
+            if (callSite.file >= files.size() || callSite.type >= types.size()) return false;
+            if (!isFunc(callSite.callee, true) || !isNode(callSite.calledNode, callSite.callee != -1)) return false;
+            if (!isNode(callSite.resultNode, true)) return false;
+            for (auto &argument: callSite.args) {
+                if (argument.node == -1 ? !isFunc(argument.func, false) : !isNode(argument.node, false)) return false;
+            }
+        }
+        for (auto &phi: phis) {
+            if (!isNode(phi.node, false)) return false;
+            for (int32_t node: phi.copies) if (!isNode(node, false)) return false;
+            for (int32_t func: phi.funcs) if (!isFunc(func, false)) return false;
+        }
+        return true;
+    }
+};
+
+#endif
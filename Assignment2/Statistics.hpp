@@ -0,0 +1,101 @@
+#ifndef ASSIGN2_STATISTICS_H
+#define ASSIGN2_STATISTICS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "ConstraintGraph.hpp"
+
+// Wall time of the analysis phases and counters of the work done, written as JSON. Timing a phase costs two clock
+// reads, so they are always taken; everything walking the constraint graph runs only when the report is written.
+class AnalysisStatistics {
+    typedef std::chrono::steady_clock Clock;
+
+    std::vector<std::pair<std::string, double>> phases; // In order of first start, times summed over starts
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    std::vector<std::pair<std::string, std::vector<uint64_t>>> histograms;
+
+public:
+    // Adds the time from its construction to its destruction to a phase
+    class Phase {
+        AnalysisStatistics &statistics;
+        std::string name;
+        Clock::time_point start;
+
+    public:
+        Phase(AnalysisStatistics &statistics, llvm::StringRef name)
+                : statistics(statistics), name(name.str()), start(Clock::now()) {}
+
+        ~Phase() {
+            statistics.addTime(name, std::chrono::duration<double>(Clock::now() - start).count());
+        }
+    };
+
+    void addTime(llvm::StringRef phase, double seconds) {
+        for (auto &entry: phases) {
+            if (entry.first != phase) continue;
+            entry.second += seconds;
+            return;
+        }
+        phases.emplace_back(phase.str(), seconds);
+    }
+
+    void setCounter(llvm::StringRef counter, uint64_t value) {
+        counters.emplace_back(counter.str(), value);
+    }
+
+    // Size and work counters of a solved constraint graph
+    void addGraph(const ConstraintGraph &graph) {
+        const ConstraintGraph::Counters &graphCounters = graph.getCounters();
+        std::pair<unsigned, uint64_t> representativeCounts = graph.getRepresentativeCounts();
+        setCounter("nodes", graph.getNodeCount());
+        setCounter("representatives", representativeCounts.first);
+        setCounter("edges", representativeCounts.second);
+        setCounter("valueConstraints", graphCounters.values);
+        setCounter("copyConstraints", graphCounters.copies);
+        setCounter("mergedNodes", graphCounters.merges);
+        setCounter("cycleCollapses", graphCounters.collapses);
+        setCounter("propagationRounds", graphCounters.sweeps);
+        setCounter("propagations", graphCounters.propagations);
+        histograms.emplace_back("pointsToSizes", graph.getPointsToHistogram());
+    }
+
+    // Histogram buckets are keyed by the range of sizes they count, e.g. "4-7"
+    void write(llvm::raw_ostream &os) const {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        llvm::json::OStream json(os, 2);
+        json.object([&] {
+            json.attributeObject("phases", [&] {
+                for (auto &phase: phases) json.attribute(phase.first, phase.second);
+            });
+            json.attributeObject("counters", [&] {
+                for (auto &counter: counters) json.attribute(counter.first, static_cast<int64_t>(counter.second));
+            });
+            for (auto &histogram: histograms) {
+                json.attributeObject(histogram.first, [&] {
+                    for (unsigned bucket = 0; bucket < histogram.second.size(); bucket++) {
+                        uint64_t low = bucket ? 1ULL << (bucket - 1) : 0, high = bucket ? (1ULL << bucket) - 1 : 0;
+                        std::string range = low == high ? std::to_string(low)
+                                                        : std::to_string(low) + "-" + std::to_string(high);
+                        json.attribute(range, static_cast<int64_t>(histogram.second[bucket]));
+                    }
+                });
+            }
+            json.attribute("peakMemoryKB", static_cast<int64_t>(usage.ru_maxrss)); // Kilobytes on Linux
+        });
+        os << "\n";
+    }
+};
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef ASSIGN2_SUMMARY_LINKER_H
+#define ASSIGN2_SUMMARY_LINKER_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
+
+#include "util.hpp"
+#include "ConstraintGraph.hpp"
+#include "CallGraphResolver.hpp"
+#include "ModuleSummary.hpp"
+#include "Statistics.hpp"
+#include "CallGraphWriter.hpp"
+
+// Links module summaries by function name into one constraint graph and resolves the global call graph, with the
+// resolution FuncPtrPass applies to a single module. Only external functions are joined by name, the local
+// functions of a module are distinct from any other. Pointer nodes of a module are offset past those of the
+// modules added before it.
+class SummaryLinker : public CallGraphResolver<SummaryLinker, unsigned> {
+    friend class CallGraphResolver<SummaryLinker, unsigned>;
+
+    std::vector<std::unique_ptr<ModuleSummary>> modules;
+    std::vector<unsigned> nodeOffsets;              // Module -> first global node
+    std::vector<std::vector<unsigned>> funcIds;     // Module -> function index -> global function ID
+
+    llvm::StringMap<unsigned> funcIdsByName;        // External function name -> ID
+    std::vector<std::string> funcNames;             // Function ID -> name
+    std::vector<std::pair<int, int>> definitions;   // Function ID -> module and function index, -1 if declared only
+    llvm::StringMap<unsigned> signatureIds;         // Function type -> signature ID
+    std::vector<std::vector<unsigned>> signatures;  // Module -> type index -> signature ID
+
+    std::vector<std::pair<unsigned, unsigned>> callSites; // Callsite ID -> module and callsite index
+
+    unsigned addFunc(llvm::StringRef name) {
+        funcNames.push_back(name.str());
+        definitions.emplace_back(-1, -1);
+        return funcNames.size() - 1;
+    }
+
+    unsigned getFuncId(llvm::StringRef name) {
+        auto inserted = funcIdsByName.insert(std::make_pair(name, static_cast<unsigned>(funcNames.size())));
+        if (inserted.second) addFunc(name);
+        return inserted.first->second;
+    }
+
+    unsigned getNode(unsigned module, int32_t node) {
+        return nodeOffsets[module] + node;
+    }
+
+    const ModuleSummary::CallSite &getCallSite(unsigned callId) const {
+        return modules[callSites[callId].first]->callSites[callSites[callId].second];
+    }
+
+    unsigned getCalledNode(unsigned callId) {
+        return getNode(callSites[callId].first, getCallSite(callId).calledNode);
+    }
+
+    unsigned getCallSignature(unsigned callId) {
+        return signatures[callSites[callId].first][getCallSite(callId).type];
+    }
+
+    llvm::StringRef getFuncName(unsigned funcId) {
+        return funcNames[funcId];
+    }
+
+    // Bind the function pointer arguments and return value of a callsite to a possible callee
+    void bindCallee(unsigned callId, unsigned calledFuncId) {
+        unsigned module = callSites[callId].first;
+        const ModuleSummary::CallSite &callSite = getCallSite(callId);
+        // Nothing reads the parameters of a declaration, nor does it return
+        if (definitions[calledFuncId].first == -1) return;
+        unsigned calledModule = definitions[calledFuncId].first;
+        const ModuleSummary::Function &calledFunc = modules[calledModule]->functions[definitions[calledFuncId].second];
+
+        for (auto &argument: callSite.args) {
+            if (argument.operandNo >= calledFunc.paramNodes.size()) continue;
+            int32_t paramNode = calledFunc.paramNodes[argument.operandNo];
+            if (paramNode == -1) continue;
+            unsigned paramId = getNode(calledModule, paramNode);
+            if (argument.node != -1) {
+                funcPtrGraph.addCopy(getNode(module, argument.node), paramId);
+            } else {
+                funcPtrGraph.addValue(paramId, funcIds[module][argument.func]);
+            }
+        }
+        if (calledFunc.returnsFuncPtr && calledFunc.retNode != -1 && callSite.resultNode != -1) {
+            funcPtrGraph.addCopy(getNode(calledModule, calledFunc.retNode), getNode(module, callSite.resultNode));
+        }
+    }
+
+public:
+    explicit SummaryLinker(bool unify = false) : CallGraphResolver(unify) {}
+
+    // Resolve the external functions of a module by name, the first definition of a name wins
+    void add(std::unique_ptr<ModuleSummary> summary) {
+        unsigned module = modules.size();
+        nodeOffsets.push_back(module ? nodeOffsets.back() + modules.back()->nodeCount : 0);
+        funcIds.emplace_back();
+        signatures.emplace_back();
+        for (auto &type: summary->types) {
+            auto inserted = signatureIds.insert(std::make_pair(type, static_cast<unsigned>(signatureIds.size())));
+            signatures.back().push_back(inserted.first->second);
+        }
+        for (unsigned index = 0; index < summary->functions.size(); index++) {
+            const ModuleSummary::Function &func = summary->functions[index];
+            unsigned funcId = func.local ? addFunc(func.name) : getFuncId(func.name);
+            funcIds.back().push_back(funcId);
+            if (func.defined && definitions[funcId].first == -1) definitions[funcId] = std::make_pair(module, index);
+        }
+        for (unsigned index = 0; index < summary->callSites.size(); index++) {
+            callSites.emplace_back(module, index);
+        }
+        modules.push_back(std::move(summary));
+    }
+
+    void link() {
+        // A function is called indirectly under the signature of its definition, or of its first declaration
+        std::vector<bool> addressTaken(funcNames.size());
+        std::vector<int> types(funcNames.size(), -1);
+        for (unsigned module = 0; module < modules.size(); module++) {
+            for (unsigned index = 0; index < modules[module]->functions.size(); index++) {
+                const ModuleSummary::Function &func = modules[module]->functions[index];
+                unsigned funcId = funcIds[module][index];
+                addressTaken[funcId] = addressTaken[funcId] || func.addressTaken;
+                if (types[funcId] == -1 || definitions[funcId] == std::make_pair(static_cast<int>(module),
+                                                                                 static_cast<int>(index))) {
+                    types[funcId] = signatures[module][func.type];
+                }
+            }
+        }
+        for (unsigned funcId = 0; funcId < funcNames.size(); funcId++) {
+            if (addressTaken[funcId]) addAddressTaken(types[funcId], funcId);
+        }
+
+        resizeCallSites(callSites.size());
+        for (unsigned module = 0; module < modules.size(); module++) {
+            const ModuleSummary &summary = *modules[module];
+            for (auto &phi: summary.phis) {
+                unsigned phiId = getNode(module, phi.node);
+                for (int32_t func: phi.funcs) funcPtrGraph.addValue(phiId, funcIds[module][func]);
+                for (int32_t node: phi.copies) funcPtrGraph.addCopy(getNode(module, node), phiId);
+            }
+        }
+        for (unsigned callId = 0; callId < callSites.size(); callId++) {
+            const ModuleSummary::CallSite &callSite = getCallSite(callId);
+            if (callSite.callee != -1) {
+                addDirectCall(callId, funcIds[callSites[callId].first][callSite.callee]);
+            } else {
+                addIndirectCall(callId);
+            }
+        }
+        resolveCallGraph();
+    }
+
+    void addStatistics(AnalysisStatistics &statistics) const {
+        statistics.setCounter("modules", modules.size());
+        statistics.setCounter("functions", funcNames.size());
+        CallGraphResolver::addStatistics(statistics);
+    }
+
+    // Function IDs are the writer's function indices, file names are kept per callsite even with a single input
+    void exportCallGraph(CallGraphWriter &writer) const {
+        for (auto &name: funcNames) writer.addFunction(name);
+        for (unsigned callId = 0; callId < callSites.size(); callId++) {
+            unsigned module = callSites[callId].first;
+            const ModuleSummary &summary = *modules[module];
+            const ModuleSummary::CallSite &callSite = getCallSite(callId);
+            writer.addCallSite(funcIds[module][callSite.caller], writer.getFile(summary.files[callSite.file]),
+                               callSite.line, callGraphEdge[callId]);
+        }
+    }
+
+    // Print the callees of every line like FuncPtrPass, prefixed by the source file when `withFile`
+    void print(bool withFile) {
+        // Rank the files by name once, so callsites are keyed by numbers rather than copied strings
+        std::map<std::string, unsigned> fileRanks;
+        if (withFile) {
+            for (auto &summary: modules) for (auto &file: summary->files) fileRanks.emplace(file, 0);
+        }
+        std::vector<const std::string *> rankedFiles;
+        for (auto &fileRank: fileRanks) {
+            fileRank.second = rankedFiles.size();
+            rankedFiles.push_back(&fileRank.first);
+        }
+        std::vector<std::vector<unsigned>> moduleFileRanks(modules.size());
+        if (withFile) {
+            for (unsigned module = 0; module < modules.size(); module++) {
+                for (auto &file: modules[module]->files) moduleFileRanks[module].push_back(fileRanks[file]);
+            }
+        }
+
+        printCallGraph([&](unsigned callId, unsigned &file, unsigned &line) {
+            const ModuleSummary::CallSite &callSite = getCallSite(callId);
+            if (withFile) file = moduleFileRanks[callSites[callId].first][callSite.file];
+            line = callSite.line;
+            return true;
+        }, rankedFiles);
+    }
+};
+
+#endif
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+# coding = utf-8
+# Generate a large synthetic module exercising function pointer arguments, phi nodes and returns.
+# Usage: generate.py [--depth D] [--table T] <groups> <output.bc> [seed]
+# Every group holds 4 leaves, a selector returning one of two function pointers, a dispatcher calling its
+# function pointer parameter and a driver wiring them to leaves of random groups. The IR is already in SSA
+# form with debug locations, one source line per callsite, and is assembled with `llvm-as`.
+# --depth adds to every group a chain of D forwarders, each passing a function pointer argument on to the next
+# forwarder of a random group and returning a phi of it and the returned one, so pointers travel D calls deep.
+# --table adds to every group a callback table of T random leaves, indexed by a switch into one phi since the
+# analysis doesn't track loads from memory. Drivers route their pointers through both.
+import argparse
+import os
+import random
+import subprocess
+
+LEAVES_PER_GROUP = 4
+FPTR = "i32 (i32)*"
+
+
+class Module:
+    def __init__(self):
+        self.functions = []
+        self.metadata = []
+        self.line = 0
+        self.next_md = 5  # !0 - !4 are fixed below
+
+    def add_md(self, text):
+        md_id = self.next_md
+        self.next_md += 1
+        self.metadata.append("!%d = %s" % (md_id, text))
+        return md_id
+
+    def begin_function(self, name):
+        self.line += 1
+        self.scope = self.add_md('distinct !DISubprogram(name: "%s", scope: !1, file: !1, line: %d, type: !3, '
+                                 'scopeLine: %d, spFlags: DISPFlagDefinition, unit: !0, retainedNodes: !4)'
+                                 % (name, self.line, self.line))
+        return self.scope
+
+    def dbg(self):
+        # Every callsite on a source line of its own
+        self.line += 1
+        return "!dbg !%d" % self.add_md("!DILocation(line: %d, scope: !%d)" % (self.line, self.scope))
+
+    def write(self, path):
+        with open(path, "w") as ll:
+            ll.write('source_filename = "synthetic.c"\n\n')
+            ll.write("declare i32 @external(i32)\n\n")
+            ll.write("\n".join(self.functions))
+            ll.write("\n!llvm.dbg.cu = !{!0}\n!llvm.module.flags = !{!2}\n\n")
+            ll.write('!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "generate.py", '
+                     'isOptimized: false, runtimeVersion: 0, emissionKind: FullDebug)\n')
+            ll.write('!1 = !DIFile(filename: "synthetic.c", directory: "/")\n')
+            ll.write('!2 = !{i32 2, !"Debug Info Version", i32 3}\n')
+            ll.write("!3 = !DISubroutineType(types: !4)\n!4 = !{}\n")
+            ll.write("\n".join(self.metadata))
+            ll.write("\n")
+
+
+def leaf(module, g, k):
+    name = "leaf_%d_%d" % (g, k)
+    scope = module.begin_function(name)
+    module.functions.append("define i32 @%s(i32 %%x) !dbg !%d {\n"
+                            "  %%r = call i32 @external(i32 %%x), %s\n"
+                            "  ret i32 %%r\n}\n" % (name, scope, module.dbg()))
+
+
+def selector(module, g, rng, groups):
+    # sel(c, a, b) returns a, b or a leaf of a random group
+    name = "sel_%d" % g
+    scope = module.begin_function(name)
+    other = "@leaf_%d_%d" % (rng.randrange(groups), rng.randrange(LEAVES_PER_GROUP))
+    module.functions.append(
+        "define %s @%s(i32 %%c, %s %%a, %s %%b) !dbg !%d {\n"
+        "entry:\n"
+        "  switch i32 %%c, label %%other [ i32 0, label %%first\n"
+        "                                i32 1, label %%second ]\n"
+        "first:\n  br label %%merge\n"
+        "second:\n  br label %%merge\n"
+        "other:\n  br label %%merge\n"
+        "merge:\n"
+        "  %%p = phi %s [ %%a, %%first ], [ %%b, %%second ], [ %s, %%other ]\n"
+        "  ret %s %%p\n}\n" % (FPTR, name, FPTR, FPTR, scope, FPTR, other, FPTR))
+
+
+def dispatcher(module, g):
+    name = "disp_%d" % g
+    scope = module.begin_function(name)
+    module.functions.append("define i32 @%s(i32 %%x, %s %%f) !dbg !%d {\n"
+                            "  %%r = call i32 %%f(i32 %%x), %s\n"
+                            "  ret i32 %%r\n}\n" % (name, FPTR, scope, module.dbg()))
+
+
+def forwarder(module, g, i, depth, rng, groups):
+    # fwd(x, f) returns f, or what the next forwarder returns for f; the last one calls f
+    name = "fwd_%d_%d" % (g, i)
+    scope = module.begin_function(name)
+    body = ["define %s @%s(i32 %%x, %s %%f) !dbg !%d {" % (FPTR, name, FPTR, scope), "entry:"]
+    if i + 1 < depth:
+        body += ["  %c = icmp eq i32 %x, 0",
+                 "  br i1 %c, label %done, label %next",
+                 "next:",
+                 "  %%r = call %s @fwd_%d_%d(i32 %%x, %s %%f), %s" % (FPTR, rng.randrange(groups), i + 1, FPTR,
+                                                                    module.dbg()),
+                 "  br label %done",
+                 "done:",
+                 "  %%p = phi %s [ %%f, %%entry ], [ %%r, %%next ]" % FPTR,
+                 "  ret %s %%p\n}\n" % FPTR]
+    else:
+        body += ["  %%r = call i32 %%f(i32 %%x), %s" % module.dbg(),
+                 "  ret %s %%f\n}\n" % FPTR]
+    module.functions.append("\n".join(body))
+
+
+def table(module, g, size, rng, groups):
+    # tbl(i) returns entry i of a table of leaves of random groups
+    name = "tbl_%d" % g
+    scope = module.begin_function(name)
+    entries = ["@leaf_%d_%d" % (rng.randrange(groups), rng.randrange(LEAVES_PER_GROUP)) for _ in range(size)]
+    body = ["define %s @%s(i32 %%i) !dbg !%d {" % (FPTR, name, scope), "entry:",
+            "  switch i32 %%i, label %%e0 [ %s ]" % " ".join("i32 %d, label %%e%d" % (k, k) for k in range(size))]
+    for k in range(size):
+        body += ["e%d:" % k, "  br label %merge"]
+    body += ["merge:",
+             "  %%p = phi %s %s" % (FPTR, ", ".join("[ %s, %%e%d ]" % (entries[k], k) for k in range(size))),
+             "  ret %s %%p\n}\n" % FPTR]
+    module.functions.append("\n".join(body))
+
+
+def routes(module, groups, depth, table_size, rng):
+    # Calls of a driver passing its selected pointer %fp through a forwarder chain and a callback table
+    lines = []
+    if depth:
+        lines += ["  %%h = call %s @fwd_%d_0(i32 %%x, %s %%fp), %s" % (FPTR, rng.randrange(groups), FPTR, module.dbg()),
+                  "  %%hr = call i32 %%h(i32 %%x), %s" % module.dbg()]
+    if table_size:
+        lines += ["  %%t = call %s @tbl_%d(i32 %%x), %s" % (FPTR, rng.randrange(groups), module.dbg()),
+                  "  %%tr = call i32 @disp_%d(i32 %%x, %s %%t), %s" % (rng.randrange(groups), FPTR, module.dbg()),
+                  "  %%tc = call i32 %%t(i32 %%tr), %s" % module.dbg()]
+    return lines
+
+
+def driver(module, g, rng, groups, depth=0, table_size=0, extra_rng=None):
+    # Select among leaves of random groups, pass the result to a random dispatcher and call it directly
+    name = "drv_%d" % g
+    scope = module.begin_function(name)
+    leaves = ["@leaf_%d_%d" % (rng.randrange(groups), rng.randrange(LEAVES_PER_GROUP)) for _ in range(2)]
+    body = ["define i32 @%s(i32 %%x) !dbg !%d {" % (name, scope),
+            "  %%fp = call %s @sel_%d(i32 %%x, %s %s, %s %s), %s"
+            % (FPTR, rng.randrange(groups), FPTR, leaves[0], FPTR, leaves[1], module.dbg()),
+            "  %%a = call i32 @disp_%d(i32 %%x, %s %%fp), %s" % (rng.randrange(groups), FPTR, module.dbg()),
+            "  %%b = call i32 %%fp(i32 %%a), %s" % module.dbg()]
+    body += routes(module, groups, depth, table_size, extra_rng)
+    if g > 0:
+        body.append("  %%c = call i32 @drv_%d(i32 %%b), %s" % (rng.randrange(g), module.dbg()))
+        body.append("  ret i32 %c\n}\n")
+    else:
+        body.append("  ret i32 %b\n}\n")
+    module.functions.append("\n".join(body))
+
+
+def main_function(module, groups):
+    scope = module.begin_function("main")
+    module.functions.append("define i32 @main() !dbg !%d {\n"
+                            "  %%r = call i32 @drv_%d(i32 0), %s\n"
+                            "  ret i32 %%r\n}\n" % (scope, groups - 1, module.dbg()))
+
+
+def generate(groups, output, seed=0, depth=0, table_size=0):
+    rng = random.Random(seed)
+    # Forwarders and tables draw from their own generator, so the base program doesn't depend on them
+    extra_rng = random.Random(seed + 1)
+    module = Module()
+    for g in range(groups):
+        for k in range(LEAVES_PER_GROUP):
+            leaf(module, g, k)
+        selector(module, g, rng, groups)
+        dispatcher(module, g)
+        for i in range(depth):
+            forwarder(module, g, i, depth, extra_rng, groups)
+        if table_size:
+            table(module, g, table_size, extra_rng, groups)
+        driver(module, g, rng, groups, depth, table_size, extra_rng)
+    main_function(module, groups)
+    ll_path = os.path.splitext(output)[0] + ".ll"
+    module.write(ll_path)
+    subprocess.check_call(["llvm-as", ll_path, "-o", output])
+    os.remove(ll_path)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Generate a large synthetic module for llvmassignment.")
+    parser.add_argument("--depth", type=int, default=0, help="forwarders per group, 0 for none")
+    parser.add_argument("--table", type=int, default=0, help="callbacks per table, 0 for no tables")
+    parser.add_argument("groups", type=int)
+    parser.add_argument("output")
+    parser.add_argument("seed", type=int, nargs="?", default=0)
+    args = parser.parse_args()
+    generate(args.groups, args.output, args.seed, args.depth, args.table)
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+# coding = utf-8
+# Run llvmassignment on synthetic modules of increasing size and report how time and memory grow.
+# Usage: scalability.py [--sizes 100,200,...] [--depth D] [--table T] [--repeat R] [--plot scalability.png]
+#                       [-- <llvmassignment options>]
+# Modules come from generate.py (--depth and --table are passed on), phase times and peak memory from the JSON
+# report of `-analysis-stats`. The growth column is the log-log slope of the wall time against the previous
+# size: about 1 for linear behaviour, 2 for quadratic. Results are written to a CSV file, and plotted when
+# matplotlib is installed.
+import argparse
+import csv
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+import generate
+
+PHASES = ["load", "mem2reg", "extract", "solve", "print"]
+
+
+def run(binary, module, options, stats):
+    start = time.perf_counter()
+    with open(os.devnull, "w") as devnull:
+        subprocess.check_call([binary, "-analysis-stats=" + stats] + options + [module], stdout=devnull)
+    wall = time.perf_counter() - start
+    with open(stats) as report:
+        return wall, json.load(report)
+
+
+def measure(args, options, workdir):
+    rows = []
+    for groups in args.sizes:
+        module = os.path.join(workdir, "synthetic%d.bc" % groups)
+        generate.generate(groups, module, args.seed, args.depth, args.table)
+        # The fastest of the repeats is the least disturbed by the rest of the machine
+        wall, report = min((run(args.binary, module, options, os.path.join(workdir, "stats.json"))
+                            for _ in range(args.repeat)), key=lambda result: result[0])
+        row = {"groups": groups, "wall": wall, "peakMB": report["peakMemoryKB"] / 1024.0}
+        for name in ["functions", "callSites", "callGraphEdges", "fixpointRounds"]:
+            row[name] = report["counters"].get(name, 0)
+        for phase in PHASES:
+            row[phase] = report["phases"].get(phase, 0.0)
+        if rows and rows[-1]["wall"] > 0 and wall > 0:
+            row["growth"] = math.log(wall / rows[-1]["wall"]) / math.log(groups / rows[-1]["groups"])
+        else:
+            row["growth"] = float("nan")
+        rows.append(row)
+        print_row(row)
+        os.remove(module)
+    return rows
+
+
+def print_header():
+    print("%8s %9s %9s %9s %9s %9s %9s %9s %9s %9s %7s %6s" % (
+        "groups", "functions", "callsites", "edges", "wall(s)", "load", "mem2reg", "extract", "solve", "print",
+        "peakMB", "growth"))
+
+
+def print_row(row):
+    print("%8d %9d %9d %9d %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f %7.1f %6.2f" % (
+        row["groups"], row["functions"], row["callSites"], row["callGraphEdges"], row["wall"],
+        row["load"], row["mem2reg"], row["extract"], row["solve"], row["print"], row["peakMB"], row["growth"]))
+    sys.stdout.flush()
+
+
+def write_csv(rows, path):
+    fields = ["groups", "functions", "callSites", "callGraphEdges", "fixpointRounds", "wall"] + PHASES + \
+             ["peakMB", "growth"]
+    with open(path, "w", newline="") as output:
+        writer = csv.DictWriter(output, fieldnames=fields)
+        writer.writeheader()
+        writer.writerows(rows)
+
+
+def plot(rows, path):
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as pyplot
+    except ImportError:
+        print("matplotlib is not installed, no plot written")
+        return
+    groups = [row["groups"] for row in rows]
+    figure, (times, memory) = pyplot.subplots(1, 2, figsize=(12, 5))
+    times.loglog(groups, [row["wall"] for row in rows], "o-", label="wall")
+    for phase in PHASES:
+        times.loglog(groups, [max(row[phase], 1e-6) for row in rows], ".--", label=phase)
+    # Linear and quadratic references through the first point
+    times.loglog(groups, [rows[0]["wall"] * size / groups[0] for size in groups], ":", color="gray", label="O(n)")
+    times.loglog(groups, [rows[0]["wall"] * (size / groups[0]) ** 2 for size in groups], ":", color="black",
+                 label="O(n^2)")
+    times.set_xlabel("groups")
+    times.set_ylabel("seconds")
+    times.legend()
+    memory.loglog(groups, [row["peakMB"] for row in rows], "o-")
+    memory.set_xlabel("groups")
+    memory.set_ylabel("peak memory (MB)")
+    figure.tight_layout()
+    figure.savefig(path)
+    print("Plot written to %s" % path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure how llvmassignment scales on synthetic modules.")
+    parser.add_argument("--sizes", default="100,200,400,800,1600,3200,6400",
+                        help="comma separated group counts passed to generate.py")
+    parser.add_argument("--depth", type=int, default=0, help="forwarders per group")
+    parser.add_argument("--table", type=int, default=0, help="callbacks per table")
+    parser.add_argument("--seed", type=int, default=0)
+    parser.add_argument("--repeat", type=int, default=1, help="runs per size, the fastest is kept")
+    parser.add_argument("--binary", default="./llvmassignment")
+    parser.add_argument("--csv", default="scalability.csv")
+    parser.add_argument("--plot", default="scalability.png")
+    parser.add_argument("options", nargs=argparse.REMAINDER, help="-- followed by llvmassignment options")
+    args = parser.parse_args()
+    args.sizes = [int(size) for size in args.sizes.split(",")]
+    options = args.options[1:] if args.options[:1] == ["--"] else args.options
+
+    print_header()
+    with tempfile.TemporaryDirectory() as workdir:
+        rows = measure(args, options, workdir)
+    write_csv(rows, args.csv)
+    print("Results written to %s" % args.csv)
+    plot(rows, args.plot)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,49 @@
+// Print a call graph written by `llvmassignment -export-callgraph` in the text format of llvmassignment, as an
+// example consumer of CallGraphReader.hpp.
+// Usage: callgraph-dump [-f] <file>, where -f prefixes every line with the source file as for several inputs.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CallGraphReader.hpp"
+
+int main(int argc, char **argv) {
+    bool withFile = argc == 3 && !strcmp(argv[1], "-f");
+    if (argc != 2 && !withFile) {
+        fprintf(stderr, "Usage: %s [-f] <file>\n", argv[0]);
+        return 1;
+    }
+    CallGraphReader reader;
+    if (!reader.open(argv[argc - 1])) {
+        fprintf(stderr, "%s: %s: not a readable call graph\n", argv[0], argv[argc - 1]);
+        return 1;
+    }
+
+    // Callees of all callsites of a line, ordered by name like llvmassignment
+    std::map<std::pair<std::string, uint32_t>, std::vector<const char *>> lineCallees;
+    for (uint32_t callSite = 0; callSite < reader.getCallSiteCount(); callSite++) {
+        CallGraphReader::Callees callees = reader.getCallees(callSite);
+        if (!callees.size()) continue;
+        auto key = std::make_pair(withFile ? reader.getFileName(reader.getFile(callSite)) : "",
+                                  reader.getLine(callSite));
+        for (uint32_t callee: callees) lineCallees[key].push_back(reader.getFunctionName(callee));
+    }
+    for (auto &line: lineCallees) {
+        std::vector<const char *> &names = line.second;
+        std::stable_sort(names.begin(), names.end(), [](const char *a, const char *b) { return strcmp(a, b) < 0; });
+        if (withFile) printf("%s:", line.first.first.c_str());
+        printf("%u :", line.first.second);
+        bool flag = true;
+        for (const char *name: names) {
+            printf(", %s" + flag, name);
+            flag = false;
+        }
+        printf("\n");
+    }
+    return 0;
+}
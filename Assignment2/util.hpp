@@ -4,13 +4,75 @@
 #include <algorithm>
 #include <vector>
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+
+// Dense IDs of pointers, numbered from 0 in first-seen order
 template<class T>
-inline static bool add_if_not_exist(std::vector<T> &sequence, const T &value) {
-    if (!std::count(sequence.begin(), sequence.end(), value)) {
-        sequence.push_back(value);
+class ValueNumbering {
+    llvm::DenseMap<T, unsigned> ids;
+    std::vector<T> values;
+
+public:
+    unsigned getId(T value) {
+        auto inserted = ids.insert(std::make_pair(value, static_cast<unsigned>(values.size())));
+        if (inserted.second) values.push_back(value);
+        return inserted.first->second;
+    }
+
+    bool hasId(T value) const {
+        return ids.count(value);
+    }
+
+    T getValue(unsigned id) const {
+        return values[id];
+    }
+
+    unsigned size() const {
+        return values.size();
+    }
+};
+
+// Set of dense IDs in insertion order, O(1) insertion and membership.
+// Indexing by position stays valid while the set grows.
+class IdSet {
+    std::vector<unsigned> elements;
+    llvm::DenseSet<unsigned> members;
+
+public:
+    // Return whether `id` was new
+    bool insert(unsigned id) {
+        if (!members.insert(id).second) return false;
+        elements.push_back(id);
         return true;
     }
-    return false;
-}
+
+    // Return whether any element of `other` was new
+    bool insert(const IdSet &other) {
+        bool changed = false;
+        for (unsigned id: other.elements) changed |= insert(id);
+        return changed;
+    }
+
+    bool contains(unsigned id) const {
+        return members.count(id);
+    }
+
+    unsigned operator[](size_t index) const {
+        return elements[index];
+    }
+
+    size_t size() const {
+        return elements.size();
+    }
+
+    std::vector<unsigned>::const_iterator begin() const {
+        return elements.begin();
+    }
+
+    std::vector<unsigned>::const_iterator end() const {
+        return elements.end();
+    }
+};
 
 #endif
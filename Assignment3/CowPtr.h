@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+/// Reference counted value copied when written while shared. Copying a CowPtr is O(1), and copies of a value only
+/// allocate again for what is modified. Values must not be modified through references kept across a copy.
+template<class T>
+class CowPtr {
+    std::shared_ptr<T> pointer;
+
+    // Default values share one empty instance, so empty facts cost nothing to build
+    static const std::shared_ptr<T> &emptyValue() {
+        static const std::shared_ptr<T> empty = std::make_shared<T>();
+        return empty;
+    }
+
+public:
+    CowPtr() : pointer(emptyValue()) {}
+
+    explicit CowPtr(T value) : pointer(std::make_shared<T>(std::move(value))) {}
+
+    const T &operator*() const {
+        return *pointer;
+    }
+
+    const T *operator->() const {
+        return pointer.get();
+    }
+
+    /// @return the value to modify, copied first if another CowPtr shares it
+    T &write() {
+        if (pointer.use_count() > 1) pointer = std::make_shared<T>(*pointer);
+        return *pointer;
+    }
+
+    bool sharesWith(const CowPtr &other) const {
+        return pointer == other.pointer;
+    }
+
+    bool operator==(const CowPtr &other) const {
+        return sharesWith(other) || *pointer == *other.pointer;
+    }
+
+    bool operator!=(const CowPtr &other) const {
+        return !(*this == other);
+    }
+};
@@ -9,9 +9,11 @@
 #ifndef _DATAFLOW_H_
 #define _DATAFLOW_H_
 
+#include <algorithm>
 #include <utility>
 #include <set>
 #include <map>
+#include <vector>
 
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/BasicBlock.h>
@@ -110,12 +112,90 @@ struct InterAnalysisInfo {
         resultContainer(resultContainer), function(function) {}
 };
 
+/// Counters of the worklist over the whole run
+struct DataflowStatistics {
+    unsigned long analyses = 0;      // Calls of analyzeForward and analyzeBackward
+    unsigned long blockVisits = 0;   // Blocks taken from the worklist
+    unsigned long factChanges = 0;   // Visits that changed the fact of the block and queued its neighbours
+};
+
+inline DataflowStatistics &getDataflowStatistics() {
+    static DataflowStatistics statistics;
+    return statistics;
+}
+
+/// Blocks of `fn` in reverse post-order from the entry, so a block comes before its successors except along back
+/// edges. Successors are explored last to first, which orders the body of a loop (the first successor of its
+/// condition) right after the condition and the loop exit after the whole loop. Unreachable blocks follow in
+/// function order.
+inline std::vector<BasicBlock *> getReversePostOrder(Function *fn) {
+    std::vector<BasicBlock *> order;
+    if (fn->empty()) return order; // A declaration has no entry block
+
+    std::set<BasicBlock *> visited;
+    // Depth-first stack of blocks with the number of their successors left to explore
+    std::vector<std::pair<BasicBlock *, unsigned>> stack;
+    BasicBlock *entry = &fn->getEntryBlock();
+    visited.insert(entry);
+    stack.emplace_back(entry, entry->getTerminator()->getNumSuccessors());
+    while (!stack.empty()) {
+        BasicBlock *bb = stack.back().first;
+        if (stack.back().second == 0) {
+            order.push_back(bb);
+            stack.pop_back();
+            continue;
+        }
+        BasicBlock *succBB = bb->getTerminator()->getSuccessor(--stack.back().second);
+        if (visited.insert(succBB).second) {
+            stack.emplace_back(succBB, succBB->getTerminator()->getNumSuccessors());
+        }
+    }
+    std::reverse(order.begin(), order.end());
+
+    for (auto bi = fn->begin(); bi != fn->end(); ++bi) {
+        if (!visited.count(&*bi)) order.push_back(&*bi);
+    }
+    return order;
+}
+
+///
+/// Worklist taking blocks by their position in a fixed order rather than by address, a block is queued once
+///
+class BlockWorkList {
+    std::vector<BasicBlock *> order;
+    std::map<BasicBlock *, unsigned> position;
+    std::set<unsigned> pending;
+
+public:
+    explicit BlockWorkList(std::vector<BasicBlock *> blockOrder) : order(std::move(blockOrder)) {
+        for (unsigned i = 0; i < order.size(); i++) position[order[i]] = i;
+    }
+
+    bool empty() const {
+        return pending.empty();
+    }
+
+    void insert(BasicBlock *bb) {
+        pending.insert(position[bb]);
+    }
+
+    BasicBlock *pop() {
+        auto first = pending.begin();
+        BasicBlock *bb = order[*first];
+        pending.erase(first);
+        return bb;
+    }
+};
+
 /// 
 /// Compute a forward iterated fixedpoint dataflow function, using a user-supplied
 /// visitor function. Note that the caller must ensure that the function is
 /// in fact a monotone function, as otherwise the fixedpoint may not terminate.
 ///
 /// Warning: This is a may forward analysis framework.
+///
+/// The fact of a block is copied on every visit, T should share its containers on copy (see PointerAnalysisFact).
+/// Blocks are visited in reverse post-order (see getReversePostOrder), a loop settles before the blocks after it.
 /// 
 /// @param fn The function
 /// @param visitor A function to compute dataflow vals
@@ -128,19 +208,21 @@ void analyzeForward(Function *fn,
                     const T &initVal, bool isEntrypoint) {
     typename DataflowResult<T>::Type &result = *resultContainer;
     InterAnalysisInfo<T> interAnalysisInfo(isEntrypoint, visitor, resultContainer, fn);
-    std::set<BasicBlock *> workList;
+    DataflowStatistics &statistics = getDataflowStatistics();
+    std::vector<BasicBlock *> order = getReversePostOrder(fn);
+    BlockWorkList workList(order);
+    statistics.analyses++;
 
     // Initialize the workList with all blocks
-    for (auto bi = fn->begin(); bi != fn->end(); ++bi) {
-        BasicBlock *bb = &*bi;
+    for (BasicBlock *bb: order) {
         result[bb] = DataflowFactPair<T>(initVal, initVal);
         workList.insert(bb);
     }
 
     // Iteratively compute the dataflow result
     while (!workList.empty()) {
-        BasicBlock *bb = *workList.begin();
-        workList.erase(workList.begin());
+        BasicBlock *bb = workList.pop();
+        statistics.blockVisits++;
 
         // Merge all incoming(input) value
         T bbFact = result[bb].input; // Warning: assign constructor used here!
@@ -157,7 +239,8 @@ void analyzeForward(Function *fn,
 
         // If outgoing value changed, propagate it along the CFG
         if (bbFact == result[bb].output) continue;
-        result[bb].output = bbFact; // Warning: assign constructor used here!
+        result[bb].output = std::move(bbFact);
+        statistics.factChanges++;
 
         // Insert successor basic block into workList
         for (auto si = succ_begin(bb); si != succ_end(bb); ++si) {
@@ -173,6 +256,9 @@ void analyzeForward(Function *fn,
 ///
 /// Warning: This is a may backward analysis framework.
 ///
+/// The fact of a block is copied on every visit, T should share its containers on copy (see PointerAnalysisFact).
+/// Blocks are visited in post-order, the reverse of the forward order.
+///
 /// @param fn The function
 /// @param visitor A function to compute dataflow vals
 /// @param resultContainer The results of the dataflow
@@ -184,19 +270,22 @@ void analyzeBackward(Function *fn,
                      const T &initVal) {
 
     typename DataflowResult<T>::Type &result = *resultContainer;
-    std::set<BasicBlock *> workList;
+    DataflowStatistics &statistics = getDataflowStatistics();
+    std::vector<BasicBlock *> order = getReversePostOrder(fn);
+    std::reverse(order.begin(), order.end());
+    BlockWorkList workList(order);
+    statistics.analyses++;
 
     // Initialize the workList with all blocks
-    for (auto bi = fn->begin(); bi != fn->end(); ++bi) {
-        BasicBlock *bb = &*bi;
+    for (BasicBlock *bb: order) {
         result[bb] = DataflowFactPair<T>(initVal, initVal);
         workList.insert(bb);
     }
 
     // Iteratively compute the dataflow result
     while (!workList.empty()) {
-        BasicBlock *bb = *workList.begin();
-        workList.erase(workList.begin());
+        BasicBlock *bb = workList.pop();
+        statistics.blockVisits++;
 
         // Merge all incoming(output) value
         T bbFact = result[bb].output; // Warning: assign constructor used here!
@@ -213,7 +302,8 @@ void analyzeBackward(Function *fn,
 
         // If outgoing value changed, propagate it along the CFG
         if (bbFact == result[bb].input) continue;
-        result[bb].input = bbFact; // Warning: assign constructor used here!
+        result[bb].input = std::move(bbFact);
+        statistics.factChanges++;
 
         // Insert precedent basic block into workList
         for (auto pi = pred_begin(bb); pi != pred_end(bb); ++pi) {
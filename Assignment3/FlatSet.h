@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+
+/// Set kept as a sorted vector, the elements inline up to N. Iterates in the same order as a std::set of the same
+/// elements, with lookups by binary search over contiguous memory and unions merged in place.
+template<class T, unsigned N = 4>
+class FlatSet {
+    llvm::SmallVector<T, N> elements;
+
+public:
+    typedef typename llvm::SmallVector<T, N>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+    FlatSet() = default;
+
+    FlatSet(std::initializer_list<T> list) {
+        for (const T &element: list) insert(element);
+    }
+
+    const_iterator begin() const {
+        return elements.begin();
+    }
+
+    const_iterator end() const {
+        return elements.end();
+    }
+
+    size_t size() const {
+        return elements.size();
+    }
+
+    bool empty() const {
+        return elements.empty();
+    }
+
+    void clear() {
+        elements.clear();
+    }
+
+    const_iterator find(const T &element) const {
+        auto position = std::lower_bound(elements.begin(), elements.end(), element);
+        return position != elements.end() && *position == element ? position : elements.end();
+    }
+
+    size_t count(const T &element) const {
+        return find(element) != end();
+    }
+
+    /// @return true if every element of `other` is in this set
+    bool includes(const FlatSet &other) const {
+        return std::includes(elements.begin(), elements.end(), other.begin(), other.end());
+    }
+
+    /// @return the position of `element` and whether it was new, like std::set
+    std::pair<const_iterator, bool> insert(const T &element) {
+        auto position = std::lower_bound(elements.begin(), elements.end(), element);
+        if (position != elements.end() && *position == element) return std::make_pair(position, false);
+        return std::make_pair(elements.insert(position, element), true);
+    }
+
+    template<class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (; first != last; ++first) insert(*first);
+    }
+
+    size_t erase(const T &element) {
+        auto position = std::lower_bound(elements.begin(), elements.end(), element);
+        if (position == elements.end() || *position != element) return 0;
+        elements.erase(position);
+        return 1;
+    }
+
+    const_iterator erase(const_iterator position) {
+        return elements.erase(position);
+    }
+
+    /// Add every element of `other` in place, merging from the back so nothing is shifted twice
+    /// @return true if any element was new
+    bool unionWith(const FlatSet &other) {
+        size_t added = 0;
+        for (auto mine = elements.begin(), theirs = other.begin(); theirs != other.end();) {
+            if (mine == elements.end() || *theirs < *mine) {
+                added++;
+                ++theirs;
+            } else if (*mine < *theirs) {
+                ++mine;
+            } else {
+                ++mine;
+                ++theirs;
+            }
+        }
+        if (!added) return false;
+
+        size_t mine = elements.size(), theirs = other.size();
+        elements.resize(mine + added);
+        for (size_t out = elements.size(); theirs;) {
+            if (mine && other.elements[theirs - 1] < elements[mine - 1]) {
+                elements[--out] = elements[--mine];
+            } else {
+                if (mine && !(elements[mine - 1] < other.elements[theirs - 1])) mine--; // Equal, kept once
+                elements[--out] = other.elements[--theirs];
+            }
+        }
+        return true;
+    }
+
+    bool operator==(const FlatSet &other) const {
+        return elements == other.elements;
+    }
+
+    bool operator!=(const FlatSet &other) const {
+        return !(*this == other);
+    }
+};
+
+/// Map kept as a vector of pairs sorted by key, iterating like a std::map
+template<class K, class V>
+class FlatMap {
+    typedef std::pair<K, V> Entry;
+    std::vector<Entry> entries;
+
+    static bool keyLess(const Entry &entry, const K &key) {
+        return entry.first < key;
+    }
+
+public:
+    typedef typename std::vector<Entry>::iterator iterator;
+    typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+    iterator begin() {
+        return entries.begin();
+    }
+
+    iterator end() {
+        return entries.end();
+    }
+
+    const_iterator begin() const {
+        return entries.begin();
+    }
+
+    const_iterator end() const {
+        return entries.end();
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    bool empty() const {
+        return entries.empty();
+    }
+
+    iterator find(const K &key) {
+        auto position = std::lower_bound(entries.begin(), entries.end(), key, keyLess);
+        return position != entries.end() && position->first == key ? position : entries.end();
+    }
+
+    const_iterator find(const K &key) const {
+        auto position = std::lower_bound(entries.begin(), entries.end(), key, keyLess);
+        return position != entries.end() && position->first == key ? position : entries.end();
+    }
+
+    size_t count(const K &key) const {
+        return find(key) != end();
+    }
+
+    V &operator[](const K &key) {
+        auto position = std::lower_bound(entries.begin(), entries.end(), key, keyLess);
+        if (position == entries.end() || position->first != key) position = entries.emplace(position, key, V());
+        return position->second;
+    }
+
+    /// @return true if every key of `other` is in this map
+    bool includesKeys(const FlatMap &other) const {
+        auto mine = entries.begin();
+        for (auto &entry: other.entries) {
+            while (mine != entries.end() && mine->first < entry.first) ++mine;
+            if (mine == entries.end() || entry.first < mine->first) return false;
+        }
+        return true;
+    }
+
+    /// Add the entries of `other` whose key is missing, existing values are kept like std::map::insert
+    void insertMissing(const FlatMap &other) {
+        // Near a fixpoint nothing is missing, which a walk over both finds without allocating
+        if (includesKeys(other)) return;
+
+        std::vector<Entry> merged;
+        merged.reserve(entries.size() + other.size());
+        auto theirs = other.entries.begin();
+        for (auto mine = entries.begin(); mine != entries.end() || theirs != other.entries.end();) {
+            if (theirs == other.entries.end() || (mine != entries.end() && mine->first < theirs->first)) {
+                merged.push_back(std::move(*mine++));
+            } else if (mine == entries.end() || theirs->first < mine->first) {
+                merged.push_back(*theirs++);
+            } else {
+                merged.push_back(std::move(*mine++));
+                ++theirs;
+            }
+        }
+        entries.swap(merged);
+    }
+
+    bool operator==(const FlatMap &other) const {
+        return entries == other.entries;
+    }
+};
@@ -46,7 +46,7 @@ public:
         }
     }
 
-    void doCallSiteCollection(const std::map<Value *, std::set<Value *>> &callGraph) {
+    void doCallSiteCollection(const PointerAnalysisFact::CallGraph &callGraph) {
         for (auto &callEdge: callGraph) {
             auto &callBase = callEdge.first;
             auto &calledFunctionSet = callEdge.second;
@@ -57,6 +57,8 @@ char InterAnalysis::ID = 2;
 static RegisterPass<InterAnalysis> IAP("InterAnalysis", "Inter-Procedure May Point-to Analysis");
 
 static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<filename>.bc"), cl::init(""));
+static cl::opt<bool> DataflowStats("dataflow-stats",
+                                   cl::desc("Print the worklist iterations of the dataflow analysis to stderr"));
 
 
 int main(int argc, char **argv) {
@@ -85,5 +87,11 @@ int main(int argc, char **argv) {
    Passes.add(new InterAnalysis());
 
    Passes.run(*M.get());
+
+   if (DataflowStats) {
+      DataflowStatistics &statistics = getDataflowStatistics();
+      errs() << "[*] Dataflow: " << statistics.analyses << " function analyses, " << statistics.blockVisits
+             << " block visits, " << statistics.factChanges << " fact changes\n";
+   }
 }
 
@@ -13,11 +13,14 @@
 #include <llvm/IR/Instructions.h>
 
 #include "Dataflow.h"
+#include "CowPtr.h"
+#include "FlatSet.h"
 
 using namespace llvm;
 
 typedef Value Object_t;
 typedef Value Pointer_t;
+typedef FlatSet<Object_t *> ObjectSet; // Also holds pointers, ordered by address like std::set
 
 static inline bool isObject(Object_t *maybeObject) {
     return isa<Instruction>(maybeObject) || isa<Argument>(maybeObject) || isa<Function>(maybeObject) ||
@@ -38,16 +41,76 @@ static inline void assertIsPointer(Pointer_t *maybePointer) {
     assert(isPointer(maybePointer));
 }
 
+/// Containers are sorted vectors behind copy-on-write pointers, so copying a fact is O(1) and a fact only copies the
+/// containers it modifies. The point-to sets are shared one by one as well, a modified fact copies the table of sets
+/// and the sets it changes. Merging facts merges the sorted vectors in place, or shares the other fact's container
+/// when this one has nothing to add. A reference to a point-to set is invalidated by updating the fact, copy the set
+/// before updating the fact while iterating it.
 class PointerAnalysisFact {
+public:
+    typedef FlatMap<Value *, FlatSet<Value *>> CallGraph;
+
 private:
-    std::set<Pointer_t *> pointerContainer;
-    std::set<Object_t *> objectContainer;
-    std::map<Pointer_t *, std::set<Object_t *>> pointToSetContainer;
-    std::set<Pointer_t *> initializedPointerContainer;
-    std::map<Pointer_t *, Pointer_t *> structToFieldMapper, fieldToStructMapper;
-    std::map<Pointer_t *, Pointer_t *> mockPointerToPointeeMapper, mockPointeeToPointerMapper;
-    std::set<Pointer_t *> isMockArrayContainer;
-    std::map<Value *, std::set<Value *>> callGraphContainer;
+    typedef CowPtr<ObjectSet> SharedObjectSet;
+    typedef CowPtr<FlatMap<Pointer_t *, Pointer_t *>> SharedMapper;
+
+    SharedObjectSet pointerContainer;
+    SharedObjectSet objectContainer;
+    CowPtr<FlatMap<Pointer_t *, SharedObjectSet>> pointToSetContainer;
+    SharedObjectSet initializedPointerContainer;
+    SharedMapper structToFieldMapper, fieldToStructMapper;
+    SharedMapper mockPointerToPointeeMapper, mockPointeeToPointerMapper;
+    SharedObjectSet isMockArrayContainer;
+    CowPtr<CallGraph> callGraphContainer;
+
+    static bool insertInto(SharedObjectSet &set, Object_t *element) {
+        if (set->count(element)) return false;
+        return set.write().insert(element).second;
+    }
+
+    static void unionInto(SharedObjectSet &dest, const SharedObjectSet &src) {
+        if (dest.sharesWith(src) || dest->includes(*src)) return;
+        if (dest->empty()) dest = src;
+        else dest.write().unionWith(*src);
+    }
+
+    static void insertMissingInto(SharedMapper &dest, const SharedMapper &src) {
+        if (dest.sharesWith(src) || dest->includesKeys(*src)) return;
+        if (dest->empty()) dest = src;
+        else dest.write().insertMissing(*src);
+    }
+
+    // Entry of `pointer` in pointToSetContainer, added empty when missing like std::map::operator[]
+    const SharedObjectSet &getPointToSetEntry(Pointer_t *pointer) {
+        auto entry = pointToSetContainer->find(pointer);
+        if (entry != pointToSetContainer->end()) return entry->second;
+        return pointToSetContainer.write()[pointer];
+    }
+
+    ObjectSet &writePointToSet(Pointer_t *pointer) {
+        return pointToSetContainer.write()[pointer].write();
+    }
+
+    bool insertPointTo(Pointer_t *pointer, Object_t *object) {
+        if (getPointToSetEntry(pointer)->count(object)) return false;
+        return writePointToSet(pointer).insert(object).second;
+    }
+
+    bool unionPointToSet(Pointer_t *pointer, const SharedObjectSet &externalObjectSet) {
+        addPointer(pointer);
+        addObjectSet(*externalObjectSet);
+
+        auto &internalObjectSet = getPointToSetEntry(pointer);
+        if (internalObjectSet.sharesWith(externalObjectSet) || internalObjectSet->includes(*externalObjectSet)) {
+            return false;
+        }
+        if (internalObjectSet->empty()) {
+            pointToSetContainer.write()[pointer] = externalObjectSet;
+            return true;
+        }
+        return writePointToSet(pointer).unionWith(*externalObjectSet);
+    }
+
 public:
     PointerAnalysisFact() = default;
 
@@ -63,10 +126,10 @@ public:
         assertIsPointer(pointer);
         bool flag = false;
 
-        flag |= pointerContainer.insert(pointer).second;
-        flag |= objectContainer.insert(pointer).second; // A pointer is an object
+        flag |= insertInto(pointerContainer, pointer);
+        flag |= insertInto(objectContainer, pointer); // A pointer is an object
         if (flag)
-            pointToSetContainer[pointer].insert(pointer).second;
+            insertPointTo(pointer, pointer);
         // A pointer treated as object should point to itself
 
         return flag;
@@ -76,18 +139,18 @@ public:
         assertIsObject(object);
         bool flag = false;
 
-        flag |= objectContainer.insert(object).second;
-        flag |= pointerContainer.insert(object).second; // To process point-to relation, we treat object as pointer
+        flag |= insertInto(objectContainer, object);
+        flag |= insertInto(pointerContainer, object); // To process point-to relation, we treat object as pointer
         if (flag)
-            pointToSetContainer[object].insert(object).second;
+            insertPointTo(object, object);
         // When initializing, an object treated as pointer should point to itself
 
         return flag;
     }
 
-    bool addObjectSet(const std::set<Object_t *> &objectSet) {
+    bool addObjectSet(const ObjectSet &objectSet) {
         bool flag = false;
-        for_each(objectSet.begin(), objectSet.end(), [&](auto *object) {
+        std::for_each(objectSet.begin(), objectSet.end(), [&](auto *object) {
             flag |= addObject(object);
         });
         return flag;
@@ -98,41 +161,37 @@ public:
         addPointer(pointer);
         addObject(object);
 
-        return pointToSetContainer[pointer].insert(object).second;
+        return insertPointTo(pointer, object);
         // Reference: https://zh.cppreference.com/w/cpp/container/set/insert
     }
 
     bool removePointTo(Pointer_t *pointer, Object_t *object) {
         addPointer(pointer);
 
-        return pointToSetContainer[pointer].erase(object);
+        if (!getPointToSetEntry(pointer)->count(object)) return false;
+        return writePointToSet(pointer).erase(object);
     }
 
     bool removePointToSelf(Pointer_t *pointer) {
         return removePointTo(pointer, pointer);
     }
 
-    bool unionPointToSet(Pointer_t *pointer, const std::set<Object_t *> &externalObjectSet) {
+    /// @return true if the point-to set of `pointer` changed
+    bool unionPointToSet(Pointer_t *pointer, const ObjectSet &externalObjectSet) {
         addPointer(pointer);
         addObjectSet(externalObjectSet);
 
-        std::set<Object_t *> tmpUnionSet;
-        auto &internalObjectSet = pointToSetContainer[pointer];
-
-        std::set_union(internalObjectSet.begin(), internalObjectSet.end(),
-                       externalObjectSet.begin(), externalObjectSet.end(),
-                       std::inserter(tmpUnionSet, tmpUnionSet.end()));
-
-        bool flag = (tmpUnionSet == internalObjectSet);
-        if (!flag) std::swap(tmpUnionSet, internalObjectSet);
-        return flag;
+        if (getPointToSetEntry(pointer)->includes(externalObjectSet)) return false;
+        return writePointToSet(pointer).unionWith(externalObjectSet);
     }
 
-    bool unionAllPointToSet(const std::set<Object_t *> &externalObjectSet) {
+    bool unionAllPointToSet(const ObjectSet &externalObjectSet) {
         bool flag = false;
 
-        for (auto &PTSKeyPair: pointToSetContainer) {
-            flag |= unionPointToSet(PTSKeyPair.first, externalObjectSet);
+        std::vector<Pointer_t *> pointers;
+        for (auto &PTSKeyPair: *pointToSetContainer) pointers.push_back(PTSKeyPair.first);
+        for (auto *pointer: pointers) {
+            flag |= unionPointToSet(pointer, externalObjectSet);
         }
 
         return flag;
@@ -141,76 +200,62 @@ public:
     void clearPointToSet(Pointer_t *pointer) {
         addPointer(pointer);
 
-        pointToSetContainer[pointer].clear();
+        if (!getPointToSetEntry(pointer)->empty()) pointToSetContainer.write()[pointer] = SharedObjectSet();
     }
 
-    const std::set<Pointer_t *> &getPointerSet() const {
-        return pointerContainer;
+    const ObjectSet &getPointerSet() const {
+        return *pointerContainer;
     }
 
-    const std::set<Object_t *> &getObjectSet() const {
-        return objectContainer;
+    const ObjectSet &getObjectSet() const {
+        return *objectContainer;
     }
 
-    const std::set<Object_t *> &getPointToSet(Pointer_t *pointer) {
+    const ObjectSet &getPointToSet(Pointer_t *pointer) {
         addPointer(pointer);
-        return pointToSetContainer[pointer];
+        return *getPointToSetEntry(pointer);
     }
 
-    const std::set<Object_t *> *getPointToSet(Pointer_t *pointer) const {
+    const ObjectSet *getPointToSet(Pointer_t *pointer) const {
         assertIsPointer(pointer);
-        if (pointToSetContainer.count(pointer) != 0)
-            return &pointToSetContainer.find(pointer)->second;
+        auto entry = pointToSetContainer->find(pointer);
+        if (entry != pointToSetContainer->end())
+            return &*entry->second;
         else
             return nullptr;
     }
 
-    std::set<Object_t *> getPointToSet(const std::set<Object_t *> &maybePointerSet) {
-        std::set<Object_t *> resultSet;
+    // Taken by value, the pointers may be added on the way, which moves the point-to sets
+    ObjectSet getPointToSet(ObjectSet maybePointerSet) {
+        ObjectSet resultSet;
         for (auto *maybePointer: maybePointerSet) {
             if (!isPointer(maybePointer)) continue;
-            auto &thisPTS = getPointToSet(maybePointer);
-            resultSet.insert(thisPTS.begin(), thisPTS.end());
+            resultSet.unionWith(getPointToSet(maybePointer));
         }
-        return std::move(resultSet);
+        return resultSet;
     }
 
+    /// @return true if a point-to set changed
     bool unionFact(const PointerAnalysisFact &src) {
         bool flag = false;
 
-        pointerContainer.insert(
-            src.pointerContainer.begin(),
-            src.pointerContainer.end()
-        );
-        objectContainer.insert(
-            src.objectContainer.begin(),
-            src.objectContainer.end()
-        );
-        initializedPointerContainer.insert(
-            src.initializedPointerContainer.begin(),
-            src.initializedPointerContainer.end()
-        );
-        structToFieldMapper.insert(
-            src.structToFieldMapper.begin(),
-            src.structToFieldMapper.end()
-        );
-        fieldToStructMapper.insert(
-            src.fieldToStructMapper.begin(),
-            src.fieldToStructMapper.end()
-        );
-        mockPointerToPointeeMapper.insert(
-            src.mockPointerToPointeeMapper.begin(),
-            src.mockPointerToPointeeMapper.end()
-        );
-        mockPointeeToPointerMapper.insert(
-            src.mockPointeeToPointerMapper.begin(),
-            src.mockPointeeToPointerMapper.end()
-        );
-        isMockArrayContainer.insert(
-            src.isMockArrayContainer.begin(),
-            src.isMockArrayContainer.end()
-        );
-        for (auto &externalPTSPair: src.pointToSetContainer) {
+        unionInto(pointerContainer, src.pointerContainer);
+        unionInto(objectContainer, src.objectContainer);
+        unionInto(initializedPointerContainer, src.initializedPointerContainer);
+        insertMissingInto(structToFieldMapper, src.structToFieldMapper);
+        insertMissingInto(fieldToStructMapper, src.fieldToStructMapper);
+        insertMissingInto(mockPointerToPointeeMapper, src.mockPointerToPointeeMapper);
+        insertMissingInto(mockPointeeToPointerMapper, src.mockPointeeToPointerMapper);
+        unionInto(isMockArrayContainer, src.isMockArrayContainer);
+        // Every pointee of a fact is in its pointer and object sets, merged above, so the point-to sets this fact
+        // shares with `src` have nothing to add
+        if (pointToSetContainer.sharesWith(src.pointToSetContainer)) return flag;
+        for (auto &externalPTSPair: *src.pointToSetContainer) {
+            auto internalPTSPair = pointToSetContainer->find(externalPTSPair.first);
+            if (internalPTSPair != pointToSetContainer->end() &&
+                internalPTSPair->second.sharesWith(externalPTSPair.second)) {
+                continue;
+            }
             flag |= unionPointToSet(externalPTSPair.first, externalPTSPair.second);
         }
 
@@ -218,8 +263,9 @@ public:
     }
 
     void setTop() {
-        for (auto *pointer: pointerContainer) {
-            pointToSetContainer[pointer] = objectContainer;
+        // All the point-to sets share the object set
+        for (auto *pointer: *pointerContainer) {
+            pointToSetContainer.write()[pointer] = objectContainer;
         }
     }
 
@@ -227,26 +273,22 @@ public:
         if (!isa<AllocaInst>(pointer)) return false;
         // When the pointer isn't initialized, add pointer to initializedPointerContainer and return true;
         // When the pointer got initialized (pointer in initializedPointerContainer), return false.
-        if (!initializedPointerContainer.count(pointer)) {
-            initializedPointerContainer.insert(pointer);
-            return true;
-        }
-        return false;
+        return insertInto(initializedPointerContainer, pointer);
     }
 
     bool isStruct(Pointer_t *maybeStructPtr) const {
-        return structToFieldMapper.count(maybeStructPtr);
+        return structToFieldMapper->count(maybeStructPtr);
     }
 
     bool isField(Pointer_t *maybeFieldPtr) const {
-        return fieldToStructMapper.count(maybeFieldPtr);
+        return fieldToStructMapper->count(maybeFieldPtr);
     }
 
     bool isArray(Pointer_t *maybeArrayPtr) const {
-        return isMockArrayContainer.count(maybeArrayPtr);
+        return isMockArrayContainer->count(maybeArrayPtr);
     }
 
-    bool isAllPointer2Struct(const std::set<Pointer_t *> &maybePtr2StructSet) const {
+    bool isAllPointer2Struct(const ObjectSet &maybePtr2StructSet) const {
         bool flag = true;
         for (auto *maybePtr2Struct: maybePtr2StructSet) {
             auto *maybeStructSet = getPointToSet(maybePtr2Struct);
@@ -255,7 +297,7 @@ public:
         return flag;
     }
 
-    bool isAllStruct(const std::set<Pointer_t *> &maybeStructPtrSet) const {
+    bool isAllStruct(const ObjectSet &maybeStructPtrSet) const {
         bool flag = true;
         for (auto *maybeStructPtr: maybeStructPtrSet) {
             flag &= isStruct(maybeStructPtr);
@@ -263,7 +305,7 @@ public:
         return flag;
     }
 
-    bool isAllField(const std::set<Pointer_t *> &maybeFieldPtrSet) const {
+    bool isAllField(const ObjectSet &maybeFieldPtrSet) const {
         bool flag = true;
         for (auto *maybeFieldPtr: maybeFieldPtrSet) {
             flag &= isField(maybeFieldPtr);
@@ -271,7 +313,7 @@ public:
         return flag;
     }
 
-    bool isAllStructFieldHybrid(const std::set<Pointer_t *> &maybeStructFieldPtrSet) const {
+    bool isAllStructFieldHybrid(const ObjectSet &maybeStructFieldPtrSet) const {
         bool flag = true;
         for (auto *maybeStructFieldPtr: maybeStructFieldPtrSet) {
             flag &= isStruct(maybeStructFieldPtr) | isField(maybeStructFieldPtr);
@@ -279,7 +321,7 @@ public:
         return flag;
     }
 
-    bool isAllArray(const std::set<Pointer_t *> &maybeArrayPtrSet) const {
+    bool isAllArray(const ObjectSet &maybeArrayPtrSet) const {
         bool flag = true;
         for (auto *maybeArrayPtr: maybeArrayPtrSet) {
             flag &= isArray(maybeArrayPtr);
@@ -287,7 +329,7 @@ public:
         return flag;
     }
 
-    bool isAllNonArray(const std::set<Pointer_t *> &maybeNonArrayPtrSet) const {
+    bool isAllNonArray(const ObjectSet &maybeNonArrayPtrSet) const {
         bool flag = true;
         for (auto *maybeNonArrayPtr: maybeNonArrayPtrSet) {
             flag &= !isArray(maybeNonArrayPtr);
@@ -295,7 +337,7 @@ public:
         return flag;
     }
 
-    bool isAllNonStructRelated(const std::set<Pointer_t *> &maybeNonStructRelatedPtrSet) const {
+    bool isAllNonStructRelated(const ObjectSet &maybeNonStructRelatedPtrSet) const {
         bool flag = true;
         for (auto *maybeNonStructPtr: maybeNonStructRelatedPtrSet) {
             flag &= !isStruct(maybeNonStructPtr) && !isField(maybeNonStructPtr);
@@ -304,12 +346,12 @@ public:
     }
 
     Pointer_t *getStructField(Pointer_t *structPtr) const {
-        assert(structToFieldMapper.count(structPtr) > 0);
-        return structToFieldMapper.find(structPtr)->second;
+        assert(structToFieldMapper->count(structPtr) > 0);
+        return structToFieldMapper->find(structPtr)->second;
     }
 
-    std::set<Pointer_t *> getAllStructField(const std::set<Pointer_t *> &structPtrSet) const {
-        std::set<Object_t *> toUnionSet;
+    ObjectSet getAllStructField(const ObjectSet &structPtrSet) const {
+        ObjectSet toUnionSet;
         for (auto *object: structPtrSet) {
             auto *RHSField = getStructField(object);
             toUnionSet.insert(RHSField);
@@ -318,17 +360,17 @@ public:
     }
 
     void setStructField(Pointer_t *structPtr, Pointer_t *fieldPtr) {
-        structToFieldMapper[structPtr] = fieldPtr;
-        fieldToStructMapper[fieldPtr] = structPtr;
+        structToFieldMapper.write()[structPtr] = fieldPtr;
+        fieldToStructMapper.write()[fieldPtr] = structPtr;
     }
 
     Pointer_t *getMockPointerPointee(Pointer_t *pointer) const {
-        assert(mockPointerToPointeeMapper.count(pointer) > 0);
-        return mockPointerToPointeeMapper.find(pointer)->second;
+        assert(mockPointerToPointeeMapper->count(pointer) > 0);
+        return mockPointerToPointeeMapper->find(pointer)->second;
     }
 
-    std::set<Pointer_t *> getAllMockPointerPointee(const std::set<Pointer_t *> &mockPointerSet) const {
-        std::set<Object_t *> toUnionSet;
+    ObjectSet getAllMockPointerPointee(const ObjectSet &mockPointerSet) const {
+        ObjectSet toUnionSet;
         for (auto *object: mockPointerSet) {
             auto *RHSPointee = getMockPointerPointee(object);
             toUnionSet.insert(RHSPointee);
@@ -337,19 +379,20 @@ public:
     }
 
     bool setMockPointerPointee(Pointer_t *pointer, Pointer_t *pointee) {
-        if (mockPointerToPointeeMapper.count(pointer) == 0) {
-            mockPointerToPointeeMapper[pointer] = pointee;
-            mockPointeeToPointerMapper[pointee] = pointer;
+        if (mockPointerToPointeeMapper->count(pointer) == 0) {
+            mockPointerToPointeeMapper.write()[pointer] = pointee;
+            mockPointeeToPointerMapper.write()[pointee] = pointer;
             return true;
         } else {
-            assert(mockPointerToPointeeMapper[pointer] == pointee);
-            assert(mockPointeeToPointerMapper[pointee] == pointer);
+            assert(mockPointerToPointeeMapper->find(pointer)->second == pointee);
+            assert(mockPointeeToPointerMapper->count(pointee) &&
+                   mockPointeeToPointerMapper->find(pointee)->second == pointer);
             return false;
         }
     }
 
     bool setIsArray(Pointer_t *arrayPtr) {
-        return isMockArrayContainer.insert(arrayPtr).second;
+        return insertInto(isMockArrayContainer, arrayPtr);
     }
 
     /* CallEdgeType:
@@ -359,11 +402,13 @@ public:
     void addCallEdge(Value *callBase, Value *function) {
         assert(isa<CallBase>(callBase) ||
                !isa<CallBase>(callBase) && isa<Function>(function));
-        callGraphContainer[callBase].insert(function);
+        auto entry = callGraphContainer->find(callBase);
+        if (entry != callGraphContainer->end() && entry->second.count(function)) return;
+        callGraphContainer.write()[callBase].insert(function);
     }
 
-    const std::map<Value *, std::set<Value *>> &getCallGraph() const {
-        return callGraphContainer;
+    const CallGraph &getCallGraph() const {
+        return *callGraphContainer;
     }
 };
 
@@ -464,7 +509,7 @@ public:
         assertIsPointer(LHS);
         assertIsPointer(RHS);
 
-        auto &LHS_PTS = fact->getPointToSet(LHS);
+        auto LHS_PTS = fact->getPointToSet(LHS); // A copy, adding pointers below moves the point-to sets
         switch (LHS_PTS.size()) {
             case 0: {
                 fact->setTop();
@@ -530,7 +575,7 @@ public:
         assertIsPointer(LHS);
         assertIsPointer(RHS);
 
-        auto &LHS_PTS = fact->getPointToSet(LHS);
+        auto LHS_PTS = fact->getPointToSet(LHS); // A copy, adding pointers below moves the point-to sets
         switch (LHS_PTS.size()) {
             case 0: {
                 fact->setTop();
@@ -587,7 +632,7 @@ public:
         assertIsPointer(LHS);
         assertIsPointer(RHS);
 
-        auto &LHS_PTS = fact->getPointToSet(LHS);
+        auto LHS_PTS = fact->getPointToSet(LHS);
         for (auto *structPtr: LHS_PTS) {
             transferFactLoadStoreStruct(fact, structPtr, RHS);
         }
@@ -598,7 +643,7 @@ public:
         assertIsPointer(LHS);
         assertIsPointer(RHS);
 
-        auto &LHS_PTS = fact->getPointToSet(LHS);
+        auto LHS_PTS = fact->getPointToSet(LHS); // A copy, adding pointers below moves the point-to sets
         switch (LHS_PTS.size()) {
             case 0: {
                 fact->setTop();
@@ -610,8 +655,7 @@ public:
                 break;
             }
             default: {
-                std::set<Pointer_t *> RHS_PTS;
-                RHS_PTS.insert(RHS);
+                ObjectSet RHS_PTS{RHS};
                 for (auto *pointer: LHS_PTS) {
                     fact->unionPointToSet(pointer, RHS_PTS);
                 }